@@ -0,0 +1,175 @@
+#include "asset_catalog.h"
+#include "uasset.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+
+#include <filesystem>
+namespace fs = std::filesystem;
+
+AssetSummary scanHeader(const std::string &path) {
+	AssetSummary summary;
+	summary.path = path;
+
+	try {
+		auto file = MappedFile::open(path);
+		if (!file) {
+			throw ParseError("Couldn't open file", 0);
+		}
+
+		AssetHeader header;
+		AssetCtx ctx;
+		ctx.header = &header;
+
+		DataBuffer dataBuf;
+		dataBuf.setupSource(file);
+		dataBuf.throwOnError = true;
+		dataBuf.ctx_ = &ctx;
+		dataBuf.serialize(header);
+
+		for (auto &&n : header.names) {
+			summary.names.emplace_back(n.name);
+		}
+
+		for (auto &&l : header.links) {
+			summary.imports.emplace_back(header.getHeaderRef(l.property));
+		}
+
+		for (auto &&c : header.catagories) {
+			summary.exports.emplace_back(header.getHeaderRef(c.objectName));
+			summary.exportClasses.emplace_back(header.getHeaderRef(header.getLinkRef(c.classIdx).property));
+		}
+
+		summary.ok = true;
+	}
+	catch (const std::exception &e) {
+		summary.error = e.what();
+	}
+
+	return summary;
+}
+
+bool AssetCatalog::load(const std::string &path) {
+	assets.clear();
+
+	auto file = MappedFile::open(path);
+	if (!file) {
+		return false;
+	}
+
+	try {
+		DataBuffer dataBuf;
+		dataBuf.setupSource(file);
+		dataBuf.throwOnError = true;
+
+		u32 magic = 0;
+		u32 version = 0;
+		dataBuf.serialize(magic);
+		dataBuf.serialize(version);
+		if (magic != MAGIC || version != VERSION) {
+			return false;
+		}
+
+		dataBuf.serialize(assets);
+	}
+	catch (const std::exception &) {
+		assets.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool AssetCatalog::save(const std::string &path) {
+	u32 magic = MAGIC;
+	u32 version = VERSION;
+
+	std::vector<u8> outData;
+	DataBuffer outBuf;
+	outBuf.setupVector(outData);
+	outBuf.loading = false;
+	outBuf.serialize(magic);
+	outBuf.serialize(version);
+	outBuf.serialize(assets);
+	outBuf.finalize();
+
+	std::ofstream outFile(path, std::ios_base::binary);
+	outFile.write((char*)outBuf.buffer, outBuf.size);
+	return outFile.good();
+}
+
+size_t AssetCatalog::update(const std::string &directory, size_t threadCount) {
+	std::unordered_map<std::string, size_t> previous;
+	for (size_t i = 0; i < assets.size(); ++i) {
+		previous.emplace(assets[i].path, i);
+	}
+
+	std::vector<AssetSummary> updated;
+	std::vector<size_t> changed;
+
+	std::error_code ec;
+	for (auto &&entry : fs::recursive_directory_iterator(directory, fs::directory_options::skip_permission_denied, ec)) {
+		if (!entry.is_regular_file(ec) || entry.path().extension() != ".uasset") {
+			continue;
+		}
+
+		auto path = entry.path().string();
+		i64 modifiedTime = entry.last_write_time(ec).time_since_epoch().count();
+		u64 fileSize = entry.file_size(ec);
+
+		auto it = previous.find(path);
+		if (it != previous.end() && assets[it->second].modifiedTime == modifiedTime && assets[it->second].fileSize == fileSize) {
+			updated.emplace_back(std::move(assets[it->second]));
+			continue;
+		}
+
+		AssetSummary summary;
+		summary.path = path;
+		summary.modifiedTime = modifiedTime;
+		summary.fileSize = fileSize;
+		updated.emplace_back(std::move(summary));
+		changed.emplace_back(updated.size() - 1);
+	}
+
+	parallel_for(changed.size(), [&](size_t i) {
+		auto &&summary = updated[changed[i]];
+		auto scanned = scanHeader(summary.path);
+		scanned.modifiedTime = summary.modifiedTime;
+		scanned.fileSize = summary.fileSize;
+		summary = std::move(scanned);
+	}, threadCount);
+
+	assets = std::move(updated);
+	return changed.size();
+}
+
+std::vector<const AssetSummary*> AssetCatalog::search(const std::string &text) const {
+	auto lower = [](std::string s) {
+		std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		return s;
+	};
+
+	auto needle = lower(text);
+	auto contains = [&](const std::string &s) {
+		return lower(s).find(needle) != std::string::npos;
+	};
+
+	std::vector<const AssetSummary*> results;
+	for (auto &&a : assets) {
+		bool match = contains(a.path);
+		for (size_t i = 0; !match && i < a.exports.size(); ++i) {
+			match = contains(a.exports[i]);
+		}
+		for (size_t i = 0; !match && i < a.imports.size(); ++i) {
+			match = contains(a.imports[i]);
+		}
+
+		if (match) {
+			results.emplace_back(&a);
+		}
+	}
+
+	return results;
+}
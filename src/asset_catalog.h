@@ -0,0 +1,54 @@
+#pragma once
+#include "core_types.h"
+#include "serialize.h"
+
+//What the header of a .uasset says about it, enough to list and search assets without loading their data
+struct AssetSummary {
+	std::string path;
+	i64 modifiedTime = 0;
+	u64 fileSize = 0;
+
+	bool ok = false;
+	std::string error;
+
+	std::vector<std::string> names;
+	std::vector<std::string> imports;
+	std::vector<std::string> exports;
+	std::vector<std::string> exportClasses;
+
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		buffer.serialize(path);
+		buffer.serialize(modifiedTime);
+		buffer.serialize(fileSize);
+		buffer.serialize(ok);
+		buffer.serialize(error);
+		buffer.serialize(names);
+		buffer.serialize(imports);
+		buffer.serialize(exports);
+		buffer.serialize(exportClasses);
+	}
+};
+
+//Parses just the AssetHeader of a .uasset, the .uexp next to it is never opened. Never throws, see AssetSummary::ok.
+AssetSummary scanHeader(const std::string &path);
+
+//Summaries of every .uasset under a folder, kept on disk so a rescan only has to parse what changed since the last one
+struct AssetCatalog {
+	std::vector<AssetSummary> assets;
+
+	//A missing or unreadable catalog leaves this one empty, which just means everything gets scanned
+	bool load(const std::string &path);
+	bool save(const std::string &path);
+
+	//Brings assets in line with the .uasset files under directory. Files with the same size and modification time
+	//as last time keep their summary, the rest are scanned on a pool of workers. Returns how many were scanned.
+	size_t update(const std::string &directory, size_t threadCount = 0);
+
+	//Assets with text (case insensitive) in their path, or in the name of one of their exports or imports
+	std::vector<const AssetSummary*> search(const std::string &text) const;
+
+private:
+	static const u32 MAGIC = 0x54414346; //FCAT
+	static const u32 VERSION = 1;
+};
@@ -0,0 +1,440 @@
+#include "asset_diff.h"
+#include "uasset.h"
+
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+	struct DiffTreeCtx {
+		AssetHeader *header = nullptr;
+		PropertyArena *arena = nullptr;
+	};
+
+	size_t hashCombine(size_t seed, size_t v) {
+		return seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+	}
+
+	std::string blobText(const u8 *data, size_t size) {
+		char hash[32];
+		snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)std::hash<std::string_view>{}(std::string_view((const char*)data, size)));
+		return std::to_string(size) + " bytes, hash " + hash;
+	}
+
+	//Sibling labels are what children are matched up by, so repeats get numbered
+	void finish(DiffNode &node) {
+		if (node.children.size() > 1) {
+			std::unordered_map<std::string, size_t> seen;
+			for (auto &&c : node.children) {
+				size_t count = seen[c.label]++;
+				if (count != 0) {
+					c.label += "#" + std::to_string(count);
+				}
+			}
+		}
+
+		size_t hash = hashCombine(std::hash<std::string>{}(node.label), std::hash<std::string>{}(node.value));
+		for (auto &&c : node.children) {
+			hash = hashCombine(hash, c.hash);
+		}
+		node.hash = hash;
+	}
+
+	DiffNode& addChild(DiffNode &parent, std::string label) {
+		parent.children.emplace_back();
+		parent.children.back().label = std::move(label);
+		return parent.children.back();
+	}
+
+	DiffNode& addLeaf(DiffNode &parent, std::string label, std::string value) {
+		auto &&node = addChild(parent, std::move(label));
+		node.value = std::move(value);
+		finish(node);
+		return node;
+	}
+
+	std::string indexLabel(size_t idx) {
+		return "[" + std::to_string(idx) + "]";
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, asset_helper::PropertyValue &v);
+
+	void build(DiffTreeCtx &, DiffNode &node, UnknownProperty &v) {
+		node.value = blobText(v.data.data(), v.data.size());
+	}
+
+	void build(DiffTreeCtx &, DiffNode &node, BoolProperty &v) {
+		node.value = v.value ? "true" : "false";
+	}
+
+	template<typename T>
+	void build(DiffTreeCtx &, DiffNode &node, PrimitiveProperty<T> &v) {
+		if constexpr (std::is_same_v<T, Guid>) {
+			for (auto &&c : v.data.guid) {
+				char hex[4];
+				snprintf(hex, sizeof(hex), "%02x", (u8)c);
+				node.value += hex;
+			}
+		}
+		else if constexpr (std::is_same_v<T, float>) {
+			char text[32];
+			snprintf(text, sizeof(text), "%.9g", v.data);
+			node.value = text;
+		}
+		else {
+			node.value = std::to_string(v.data);
+		}
+	}
+
+	void build(DiffTreeCtx &, DiffNode &node, TextProperty &v) {
+		for (auto &&s : v.strings) {
+			if (!node.value.empty()) {
+				node.value += ", ";
+			}
+			node.value += "\"" + s + "\"";
+		}
+	}
+
+	void build(DiffTreeCtx &, DiffNode &node, StringProperty &v) {
+		node.value = "\"" + v.str + "\"";
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, ObjectProperty &v) {
+		if (ctx.header == nullptr) {
+			node.value = v.type.str + " " + v.value.str;
+		}
+		else if (v.linkVal == 0) {
+			node.value = "None";
+		}
+		else if (v.linkVal > 0 && (size_t)v.linkVal <= ctx.header->catagories.size()) {
+			node.value = ctx.header->getHeaderRef(ctx.header->catagories[v.linkVal - 1].objectName);
+		}
+		else {
+			auto &&link = ctx.header->getLinkRef(v.linkVal);
+			node.value = ctx.header->getHeaderRef(ctx.header->getLinkRef(link.link).property) + "." + ctx.header->getHeaderRef(link.property);
+		}
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, EnumProperty &v) {
+		node.value = v.value.getString(ctx.header);
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, ByteProperty &v) {
+		node.value = v.enumType.getString(ctx.header) + " " + std::to_string(v.value);
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, NameProperty &v) {
+		node.value = v.name.getString(ctx.header);
+		if (v.v != 0) {
+			node.value += " #" + std::to_string(v.v);
+		}
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, SoftObjectProperty &v) {
+		node.value = v.name.getString(ctx.header) + " " + std::to_string(v.value);
+	}
+
+	void build(DiffTreeCtx &, DiffNode &node, DateTime &v) {
+		node.value = std::to_string(v.time);
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, IPropertyValue *v) {
+		build(ctx, node, v->v);
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, PropertyData &v) {
+		build(ctx, node, v.getValue(ctx.header, *ctx.arena));
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, IPropertyDataList *v) {
+		for (auto &&p : v->properties) {
+			auto &&child = addChild(node, p.nameRef.getString(ctx.header));
+			build(ctx, child, p);
+			finish(child);
+		}
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, ArrayProperty &v) {
+		node.value = "Array of " + v.arrayType.getString(ctx.header);
+
+		size_t idx = 0;
+		for (auto &&e : v.values) {
+			auto &&child = addChild(node, indexLabel(idx++));
+			build(ctx, child, e);
+			finish(child);
+		}
+
+		std::visit([&](auto &&elements) {
+			using T = std::decay_t<decltype(elements)>;
+			if constexpr (!std::is_same_v<T, std::monostate>) {
+				for (auto &&e : elements) {
+					auto &&child = addChild(node, indexLabel(idx++));
+					build(ctx, child, e);
+					finish(child);
+				}
+			}
+		}, v.typed);
+	}
+
+	//Pairs are labelled by their key when it's a plain value, so an inserted pair doesn't shift the ones after it
+	void build(DiffTreeCtx &ctx, DiffNode &node, MapProperty &v) {
+		node.value = "Map of " + v.keyType.getString(ctx.header) + " to " + v.valueType.getString(ctx.header);
+
+		size_t idx = 0;
+		for (auto &&pair : v.map) {
+			DiffNode key;
+			build(ctx, key, pair.key);
+
+			if (key.children.empty()) {
+				auto &&child = addChild(node, "[" + key.value + "]");
+				build(ctx, child, pair.value);
+				finish(child);
+			}
+			else {
+				auto &&child = addChild(node, indexLabel(idx));
+
+				key.label = "Key";
+				finish(key);
+				child.children.emplace_back(std::move(key));
+
+				auto &&value = addChild(child, "Value");
+				build(ctx, value, pair.value);
+				finish(value);
+
+				finish(child);
+			}
+			++idx;
+		}
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, StructProperty &v) {
+		node.value = v.type.getString(ctx.header);
+
+		//Most structs are a single property list, which reads better without an extra [0] in every path
+		if (v.values.size() == 1) {
+			if (auto list = std::get_if<IPropertyDataList*>(&v.values[0]->v)) {
+				build(ctx, node, *list);
+				return;
+			}
+		}
+
+		size_t idx = 0;
+		for (auto &&e : v.values) {
+			auto &&child = addChild(node, indexLabel(idx++));
+			build(ctx, child, e);
+			finish(child);
+		}
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, asset_helper::PropertyValue &v) {
+		std::visit([&](auto &&value) {
+			build(ctx, node, value);
+		}, v);
+	}
+
+	void buildProperties(DiffTreeCtx &ctx, DiffNode &parent, const std::string &label, IPropertyDataList &list) {
+		auto &&node = addChild(parent, label);
+		build(ctx, node, &list);
+		finish(node);
+	}
+
+	//Resource headers only matter as a whole, so they're compared by the bytes they save as
+	template<typename T>
+	std::string resourceText(T &resource) {
+		std::vector<u8> bytes;
+		DataBuffer buffer;
+		buffer.setupVector(bytes);
+		buffer.loading = false;
+		buffer.serialize(resource);
+		return blobText(bytes.data(), bytes.size());
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, UObject &v) {
+		build(ctx, node, &v.data);
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, DataTableCategory &v) {
+		buildProperties(ctx, node, "Properties", v.base.data);
+
+		auto &&rows = addChild(node, "Rows");
+		for (auto &&e : v.entries) {
+			auto &&row = addChild(rows, e.rowName.getString(ctx.header));
+			build(ctx, row, e.value);
+			finish(row);
+		}
+		finish(rows);
+	}
+
+	void build(DiffTreeCtx &ctx, DiffNode &node, HmxAssetFile &v) {
+		buildProperties(ctx, node, "Properties", v.propList);
+		addLeaf(node, "OriginalFilename", v.originalFilename);
+
+		auto &&files = addChild(node, "Files");
+		for (auto &&f : v.audio.audioFiles) {
+			auto &&file = addChild(files, f.fileName);
+			file.value = f.fileType;
+
+			std::visit([&](auto &&resource) {
+				using T = std::decay_t<decltype(resource)>;
+				if constexpr (std::is_same_v<T, HmxAudio::PackageFile::MoggSampleResourceHeader> || std::is_same_v<T, HmxAudio::PackageFile::MidiMusicResource>) {
+					addLeaf(file, "Header", resourceText(resource));
+				}
+			}, f.resourceHeader);
+
+			addLeaf(file, "Data", blobText(f.fileData.data(), f.fileData.size()));
+			finish(file);
+		}
+		finish(files);
+	}
+
+	void buildHeader(DiffNode &node, AssetHeader &header) {
+		//Labelled by the names themselves, so one name added in the middle doesn't show up as every name after it changing
+		auto &&names = addChild(node, "Names");
+		for (auto &&n : header.names) {
+			addLeaf(names, n.name, "");
+		}
+		finish(names);
+
+		auto &&imports = addChild(node, "Imports");
+		for (auto &&l : header.links) {
+			addLeaf(imports, header.getHeaderRef(l.property), header.getHeaderRef(l.cls));
+		}
+		finish(imports);
+	}
+
+	void buildExports(DiffNode &node, AssetHeader &header, AssetData &data) {
+		DiffTreeCtx ctx;
+		ctx.header = &header;
+		ctx.arena = &data.arena;
+
+		auto &&exports = addChild(node, "Exports");
+		for (size_t i = 0; i < data.catagoryValues.size() && i < header.catagories.size(); ++i) {
+			auto &&c = header.catagories[i];
+			auto &&value = data.catagoryValues[i];
+
+			auto &&e = addChild(exports, header.getHeaderRef(c.objectName));
+			e.value = header.getHeaderRef(header.getLinkRef(c.classIdx).property);
+
+			std::visit([&](auto &&v) {
+				build(ctx, e, v);
+			}, value.value);
+
+			if (value.extraData.size() != 0) {
+				addLeaf(e, "ExtraData", blobText(value.extraData.data(), value.extraData.size()));
+			}
+			finish(e);
+		}
+		finish(exports);
+	}
+
+	std::string joinPath(const std::string &path, const std::string &label) {
+		if (path.empty()) {
+			return label;
+		}
+		if (!label.empty() && label[0] == '[') {
+			return path + label;
+		}
+		return path + "." + label;
+	}
+
+	void diffNodes(const DiffNode &before, const DiffNode &after, const std::string &path, std::vector<AssetDifference> &out) {
+		if (before.hash == after.hash) {
+			return;
+		}
+
+		if (before.value != after.value) {
+			out.push_back({ AssetDifference::Kind::Changed, path, before.value, after.value });
+		}
+
+		std::unordered_map<std::string, size_t> afterIdx;
+		for (size_t i = 0; i < after.children.size(); ++i) {
+			afterIdx.emplace(after.children[i].label, i);
+		}
+
+		std::vector<bool> matched(after.children.size(), false);
+		for (auto &&c : before.children) {
+			auto it = afterIdx.find(c.label);
+			if (it == afterIdx.end()) {
+				out.push_back({ AssetDifference::Kind::Removed, joinPath(path, c.label), c.value, "" });
+				continue;
+			}
+
+			matched[it->second] = true;
+			diffNodes(c, after.children[it->second], joinPath(path, c.label), out);
+		}
+
+		for (size_t i = 0; i < after.children.size(); ++i) {
+			if (!matched[i]) {
+				auto &&c = after.children[i];
+				out.push_back({ AssetDifference::Kind::Added, joinPath(path, c.label), "", c.value });
+			}
+		}
+	}
+}
+
+DiffNode buildDiffTree(AssetHeader &header, AssetData &data) {
+	DiffNode root;
+	buildHeader(root, header);
+	buildExports(root, header, data);
+	finish(root);
+	return root;
+}
+
+DiffNode buildDiffTree(PakFile &pak) {
+	pak.loadEntries();
+
+	DiffNode root;
+	addLeaf(root, "MountPoint", pak.mountPoint);
+
+	auto &&entries = addChild(root, "Entries");
+	for (auto &&e : pak.entries) {
+		auto &&entry = addChild(entries, e.name);
+
+		if (auto header = std::get_if<AssetHeader>(&e.data)) {
+			buildHeader(entry, *header);
+		}
+		else {
+			auto &&assetData = e.getData();
+			buildExports(entry, e.getHeader(), assetData.data);
+		}
+		finish(entry);
+	}
+	finish(entries);
+
+	finish(root);
+	return root;
+}
+
+std::vector<AssetDifference> diffTrees(const DiffNode &before, const DiffNode &after) {
+	std::vector<AssetDifference> differences;
+	diffNodes(before, after, "", differences);
+	return differences;
+}
+
+std::vector<AssetDifference> diffAssets(Asset &before, Asset &after) {
+	return diffTrees(buildDiffTree(before.header, before.data), buildDiffTree(after.header, after.data));
+}
+
+std::vector<AssetDifference> diffPaks(PakFile &before, PakFile &after) {
+	return diffTrees(buildDiffTree(before), buildDiffTree(after));
+}
+
+void printDifferences(const std::vector<AssetDifference> &differences, size_t maxPrinted) {
+	for (size_t i = 0; i < differences.size() && i < maxPrinted; ++i) {
+		auto &&d = differences[i];
+		switch (d.kind) {
+		case AssetDifference::Kind::Changed:
+			printf("Changed %s: %s -> %s\n", d.path.c_str(), d.before.c_str(), d.after.c_str());
+			break;
+		case AssetDifference::Kind::Added:
+			printf("Added %s: %s\n", d.path.c_str(), d.after.c_str());
+			break;
+		case AssetDifference::Kind::Removed:
+			printf("Removed %s: %s\n", d.path.c_str(), d.before.c_str());
+			break;
+		}
+	}
+
+	if (differences.size() > maxPrinted) {
+		printf("...and %zu more differences\n", differences.size() - maxPrinted);
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "core_types.h"
+
+struct AssetHeader;
+struct AssetData;
+struct Asset;
+struct PakFile;
+
+//A property, export, row or file of an asset, with a hash of everything under it.
+//Two subtrees with the same hash are taken as equal without walking them.
+struct DiffNode {
+	std::string label;
+
+	//What's shown for this node when it changed. Containers have their type here.
+	std::string value;
+
+	size_t hash = 0;
+	std::vector<DiffNode> children;
+};
+
+struct AssetDifference {
+	enum class Kind {
+		Changed,
+		Added,
+		Removed
+	};
+
+	Kind kind;
+
+	//Like Exports.DT_SongData.Rows.custom_song.Title, or Entries.<entry name>.Exports.Meta_custom_songbs.BPM for a pak
+	std::string path;
+	std::string before;
+	std::string after;
+};
+
+//Deferred properties are decoded while the tree is built
+DiffNode buildDiffTree(AssetHeader &header, AssetData &data);
+DiffNode buildDiffTree(PakFile &pak);
+
+std::vector<AssetDifference> diffTrees(const DiffNode &before, const DiffNode &after);
+
+std::vector<AssetDifference> diffAssets(Asset &before, Asset &after);
+std::vector<AssetDifference> diffPaks(PakFile &before, PakFile &after);
+
+void printDifferences(const std::vector<AssetDifference> &differences, size_t maxPrinted = 50);
@@ -0,0 +1,101 @@
+#include "asset_scan.h"
+#include "uasset.h"
+#include "thread_pool.h"
+
+#include <filesystem>
+namespace fs = std::filesystem;
+
+static void scanPak(const std::string &path, ScanResult &result) {
+	auto file = MappedFile::open(path);
+	if (!file) {
+		throw ParseError("Couldn't open file", 0);
+	}
+
+	//Decode every property, a bad one would otherwise only show up once it's used
+	PakFile pak;
+	pak.deferProperties = false;
+
+	DataBuffer dataBuf;
+	dataBuf.setupSource(file);
+	dataBuf.throwOnError = true;
+	dataBuf.serialize(pak);
+
+	result.count = pak.entries.size();
+}
+
+static void scanAsset(const std::string &path, ScanResult &result) {
+	auto assetFile = fs::path(path);
+	auto uexpFile = assetFile.parent_path() / (assetFile.stem().string() + ".uexp");
+
+	std::ifstream infile(assetFile, std::ios_base::binary);
+	std::ifstream uexpfile(uexpFile, std::ios_base::binary);
+	if (!infile || !uexpfile) {
+		throw ParseError("Couldn't open the .uasset or its .uexp", 0);
+	}
+
+	std::vector<u8> fileData = std::vector<u8>(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+	fileData.insert(fileData.end(), std::istreambuf_iterator<char>(uexpfile), std::istreambuf_iterator<char>());
+
+	Asset asset;
+	DataBuffer dataBuf;
+	dataBuf.setupVector(fileData);
+	dataBuf.throwOnError = true;
+	dataBuf.serialize(asset);
+
+	result.count = asset.header.exportsCount;
+}
+
+ScanResult scanFile(const std::string &path) {
+	ScanResult result;
+	result.path = path;
+
+	try {
+		if (fs::path(path).extension() == ".pak") {
+			scanPak(path, result);
+		}
+		else {
+			scanAsset(path, result);
+		}
+
+		result.ok = true;
+	}
+	catch (const ParseError &e) {
+		result.error = e.what();
+		result.errorOffset = e.offset;
+	}
+	//Anything else the parsers can throw on garbage (bad_alloc from a huge count that slipped through, stoi, ...)
+	catch (const std::exception &e) {
+		result.error = e.what();
+	}
+
+	return result;
+}
+
+std::vector<std::string> findAssetFiles(const std::string &directory) {
+	std::vector<std::string> files;
+
+	std::error_code ec;
+	for (auto &&entry : fs::recursive_directory_iterator(directory, fs::directory_options::skip_permission_denied, ec)) {
+		if (!entry.is_regular_file(ec)) {
+			continue;
+		}
+
+		auto ext = entry.path().extension();
+		if (ext == ".pak" || ext == ".uasset") {
+			files.emplace_back(entry.path().string());
+		}
+	}
+
+	return files;
+}
+
+std::vector<ScanResult> scanDirectory(const std::string &directory, size_t threadCount) {
+	auto files = findAssetFiles(directory);
+
+	std::vector<ScanResult> results(files.size());
+	parallel_for(files.size(), [&](size_t i) {
+		results[i] = scanFile(files[i]);
+	}, threadCount);
+
+	return results;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "core_types.h"
+
+struct ScanResult {
+	std::string path;
+	bool ok = false;
+
+	//Only set when ok is false. errorOffset is from the start of the file, for a uasset it carries on into the .uexp.
+	std::string error;
+	size_t errorOffset = 0;
+
+	//Entries for a pak, exports for a uasset
+	size_t count = 0;
+};
+
+//Parses a single .pak, or a .uasset along with the .uexp next to it. Never breaks into the debugger or throws,
+//a bad file stops at its first error and comes back with ok set to false.
+ScanResult scanFile(const std::string &path);
+
+//Every .pak and .uasset under directory, in the order they're found
+std::vector<std::string> findAssetFiles(const std::string &directory);
+
+//Parses every .pak and .uasset under directory on a pool of workers, see scanFile.
+//Results are in the same order as the files were found.
+std::vector<ScanResult> scanDirectory(const std::string &directory, size_t threadCount = 0);
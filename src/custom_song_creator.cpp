@@ -2,14 +2,16 @@
 #include <Windows.h>
 
 #include "uasset.h"
+#include "file_sink.h"
+#include "asset_scan.h"
 #include "imgui.h"
 #include "imgui_internal.h"
 #include "imgui_stdlib.h"
-#include "crc.h"
 #include <optional>
 #include <algorithm>
 #include <array>
 #include <unordered_set>
+#include <chrono>
 
 #include <filesystem>
 namespace fs = std::filesystem;
@@ -19,6 +21,7 @@ namespace fs = std::filesystem;
 #include "moggcrypt/CCallbacks.h"
 #include "moggcrypt/VorbisEncrypter.h"
 
+#include "pak_reference_graph.h"
 #include "fuser_asset.h"
 
 #include "bass/bass.h"
@@ -287,9 +290,14 @@ struct MainContext {
 	struct CurrentPak {
 		PakFile pak;
 		AssetRoot root;
+
+		//File the pak was opened from. Blobs in the pak may still be views into it.
+		std::shared_ptr<MappedFile> source;
 	};
 	std::unique_ptr<CurrentPak> currentPak;
 
+	//Leave names nothing refers to anymore out of the saved assets
+	bool dropUnusedNames = false;
 };
 MainContext gCtx;
 
@@ -298,6 +306,7 @@ void load_file(DataBuffer &&dataBuf) {
 	gCtx.saveLocation.clear();
 
 	auto &&pak = gCtx.currentPak->pak;
+	gCtx.currentPak->source = dataBuf.source;
 
 	dataBuf.serialize(pak);
 
@@ -328,59 +337,96 @@ void load_file(DataBuffer &&dataBuf) {
 		__debugbreak();
 	}
 
+	PakReferenceGraph graph;
+	graph.build(pak);
+
 	SongSerializationCtx ctx;
 	ctx.loading = true;
 	ctx.pak = &pak;
+	ctx.graph = &graph;
 	gCtx.currentPak->root.serialize(ctx);
 }
 
 void load_template() {
 	DataBuffer dataBuf;
-	dataBuf.buffer = (u8*)custom_song_pak_template;
-	dataBuf.size = sizeof(custom_song_pak_template);
+	dataBuf.setupSource(MappedFile::fromMemory(custom_song_pak_template, sizeof(custom_song_pak_template)));
 	load_file(std::move(dataBuf));
 }
 
+//Shown in a popup when set
+std::string Error_SaveFailed;
+
 void save_file() {
 	SongSerializationCtx ctx;
 	ctx.loading = false;
 	ctx.pak = &gCtx.currentPak->pak;
 	gCtx.currentPak->root.serialize(ctx);
 
-	std::vector<u8> outData;
-	DataBuffer outBuf;
-	outBuf.setupVector(outData);
-	outBuf.loading = false;
-	gCtx.currentPak->pak.serialize(outBuf);
-	outBuf.finalize();
-
 	std::string basePath = fs::path(gCtx.saveLocation).parent_path().string() + "/";
-	std::ofstream outPak(basePath + gCtx.currentPak->root.shortName + "_P.pak", std::ios_base::binary);
-	outPak.write((char*)outBuf.buffer, outBuf.size);
+	std::string pakPath = basePath + gCtx.currentPak->root.shortName + "_P.pak";
+
+	//We can't overwrite the file we're still mapped to, so pull it into memory first
+	auto &&source = gCtx.currentPak->source;
+	std::error_code ec;
+	if (source && !source->path.empty() && fs::equivalent(source->path, pakPath, ec)) {
+		source->detach();
+	}
 
+	gCtx.currentPak->pak.dropUnusedNames = gCtx.dropUnusedNames;
+
+	std::vector<u32> chunkCrcs;
+	std::string error;
 	{
-		PakSigFile sigFile;
-		sigFile.encrypted_total_hash.resize(512);
+		FileSink sink;
+		if (!sink.open(pakPath)) {
+			printf("Failed to open %s for writing!\n", pakPath.c_str());
+			Error_SaveFailed = "Couldn't open " + pakPath + " for writing.";
+			return;
+		}
 
-		const u32 chunkSize = 64 * 1024;
-		for (size_t start = 0; start < outBuf.size; start += chunkSize) {
-			size_t end = start + chunkSize;
-			if (end > outBuf.size) {
-				end = outBuf.size;
-			}
+		try {
+			DataBuffer outBuf;
+			outBuf.setupSink(sink);
 
-			sigFile.chunks.emplace_back(CRC::MemCrc32(outBuf.buffer + start, end - start));
+			//Settle every offset and size first, so nothing behind the sink's window has to change
+			outBuf.measure(gCtx.currentPak->pak);
+			outBuf.serialize(gCtx.currentPak->pak);
+			outBuf.finalize();
+			chunkCrcs = sink.chunkCrcs;
 		}
+		catch (const SinkError &e) {
+			error = e.what();
+		}
+	}
+
+	//A partly written pak would only fail to load in game, so nothing is left behind
+	if (!error.empty()) {
+		printf("Failed to save %s: %s\n", pakPath.c_str(), error.c_str());
+		fs::remove(pakPath, ec);
+		Error_SaveFailed = "Saving " + pakPath + " failed: " + error;
+		return;
+	}
+
+	{
+		PakSigFile sigFile;
+		sigFile.encrypted_total_hash.resize(512);
+		sigFile.chunks = chunkCrcs;
 
 		std::vector<u8> sigOutData;
 		DataBuffer sigOutBuf;
 		sigOutBuf.setupVector(sigOutData);
 		sigOutBuf.loading = false;
-		sigFile.serialize(sigOutBuf);
+		sigOutBuf.serialize(sigFile);
 		sigOutBuf.finalize();
 
-		std::ofstream outPak(basePath + gCtx.currentPak->root.shortName + "_P.sig", std::ios_base::binary);
-		outPak.write((char*)sigOutBuf.buffer, sigOutBuf.size);
+		std::string sigPath = basePath + gCtx.currentPak->root.shortName + "_P.sig";
+		std::ofstream outSig(sigPath, std::ios_base::binary);
+		outSig.write((char*)sigOutBuf.buffer, sigOutBuf.size);
+		outSig.close();
+		if (!outSig) {
+			printf("Failed to write %s!\n", sigPath.c_str());
+			Error_SaveFailed = "Writing " + sigPath + " failed.";
+		}
 	}
 }
 
@@ -738,6 +784,8 @@ void custom_song_creator_update(size_t width, size_t height) {
 				select_save_location();
 			}
 
+			ImGui::MenuItem("Drop Unused Names On Save", nullptr, &gCtx.dropUnusedNames);
+
 			ImGui::EndMenu();
 		}
 
@@ -794,7 +842,7 @@ void custom_song_creator_update(size_t width, size_t height) {
 				getData = [](const Asset &asset) {
 					auto &&midiAsset = std::get<HmxAssetFile>(asset.data.catagoryValues[0].value);
 					auto &&fileData = midiAsset.audio.audioFiles[0].fileData;
-					return fileData;
+					return fileData.toVector();
 				};
 			}
 
@@ -819,6 +867,56 @@ void custom_song_creator_update(size_t width, size_t height) {
 				};
 			}
 
+			if (ImGui::MenuItem("Scan Folder For Bad Files")) {
+				auto file = OpenFile("Pak or Unreal Asset File (*.pak;*.uasset)\0*.pak;*.uasset\0");
+				if (file) {
+					auto results = scanDirectory(fs::path(*file).parent_path().string());
+
+					size_t failed = 0;
+					for (auto &&r : results) {
+						if (!r.ok) {
+							printf("%s: %s (at 0x%zx)\n", r.path.c_str(), r.error.c_str(), r.errorOffset);
+							++failed;
+						}
+					}
+					printf("Scanned %zu files, %zu failed\n", results.size(), failed);
+				}
+			}
+
+			if (ImGui::MenuItem("Benchmark Template Load/Save")) {
+				const int iterations = 50;
+				auto source = MappedFile::fromMemory(custom_song_pak_template, sizeof(custom_song_pak_template));
+
+				auto loadStart = std::chrono::high_resolution_clock::now();
+				for (int i = 0; i < iterations; ++i) {
+					PakFile pak;
+					DataBuffer dataBuf;
+					dataBuf.setupSource(source);
+					dataBuf.serialize(pak);
+				}
+				auto loadEnd = std::chrono::high_resolution_clock::now();
+
+				PakFile pak;
+				DataBuffer dataBuf;
+				dataBuf.setupSource(source);
+				dataBuf.serialize(pak);
+
+				auto saveStart = std::chrono::high_resolution_clock::now();
+				for (int i = 0; i < iterations; ++i) {
+					std::vector<u8> outData;
+					DataBuffer outBuf;
+					outBuf.setupVectorFor(outData, pak);
+					outBuf.serialize(pak);
+					outBuf.finalize();
+				}
+				auto saveEnd = std::chrono::high_resolution_clock::now();
+
+				printf("Template load: %.3f ms, save: %.3f ms (average of %d)\n",
+					std::chrono::duration<double, std::milli>(loadEnd - loadStart).count() / iterations,
+					std::chrono::duration<double, std::milli>(saveEnd - saveStart).count() / iterations,
+					iterations);
+			}
+
 			if (extract_uexp) {
 				auto file = OpenFile("Unreal Asset File (*.uasset)\0*.uasset\0");
 				if (file) {
@@ -837,7 +935,7 @@ void custom_song_creator_update(size_t width, size_t height) {
 					dataBuf.setupVector(fileData);
 
 					Asset a;
-					a.serialize(dataBuf);
+					dataBuf.serialize(a);
 
 					auto out_file = SaveFile(save_file.c_str(), ext.c_str(), "");
 					if (out_file) {
@@ -870,14 +968,13 @@ void custom_song_creator_update(size_t width, size_t height) {
 	if (do_open) {
 		auto file = OpenFile("Fuser Custom Song (*.pak)\0*.pak\0");
 		if (file) {
-			std::ifstream infile(*file, std::ios_base::binary);
-			std::vector<u8> fileData = std::vector<u8>(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
-
-			DataBuffer dataBuf;
-			dataBuf.setupVector(fileData);
-			load_file(std::move(dataBuf));
+			if (auto mapped = MappedFile::open(*file)) {
+				DataBuffer dataBuf;
+				dataBuf.setupSource(mapped);
+				load_file(std::move(dataBuf));
 
-			gCtx.saveLocation = *file;
+				gCtx.saveLocation = *file;
+			}
 		}
 	}
 
@@ -930,6 +1027,14 @@ void custom_song_creator_update(size_t width, size_t height) {
 		auto fileName = gCtx.currentPak->root.shortName + "_P.pak";
 		auto error = "Your file must be named as " + fileName + ", otherwise the song loader won't unlock it!";
 		ErrorModal("Invalid File Name", error.c_str());
+
+		static std::string saveFailedMessage;
+		if (!Error_SaveFailed.empty()) {
+			ImGui::OpenPopup("Save Failed");
+			saveFailedMessage = std::move(Error_SaveFailed);
+			Error_SaveFailed.clear();
+		}
+		ErrorModal("Save Failed", saveFailedMessage.c_str());
 	}
 	else {
 		ImGui::Text("Welcome to the Fuser Custom Song Creator!");
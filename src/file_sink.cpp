@@ -0,0 +1,207 @@
+#include "file_sink.h"
+#include "crc.h"
+
+#include <algorithm>
+#include <string>
+
+bool FileSink::open(const std::string &path) {
+	file.open(path, std::ios_base::in | std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+
+	chunkCrcs.clear();
+	window.clear();
+	windowStart = 0;
+	hashing = false;
+	hashedRanges.clear();
+	currentCrc = 0;
+
+	return file.is_open();
+}
+
+void FileSink::write(size_t at, const u8 *data, size_t size) {
+	//Committed bytes have already been hashed, so rewriting them is only fine if nothing changes
+	if (at < windowStart) {
+		size_t committedSize = std::min(size, windowStart - at);
+
+		std::vector<u8> existing(committedSize);
+		readBack(at, existing.data(), committedSize);
+		if (memcmp(existing.data(), data, committedSize) != 0) {
+			throw SinkError("Bytes at " + std::to_string(at) + " changed after they were written out and checksummed");
+		}
+
+		at += committedSize;
+		data += committedSize;
+		size -= committedSize;
+		if (size == 0) {
+			return;
+		}
+	}
+
+	size_t windowEnd = windowStart + window.size();
+
+	//Big appends (like moggs) go straight out instead of through the window
+	if (at == windowEnd && window.size() + size > WINDOW_SIZE) {
+		commitTo(windowEnd);
+
+		size_t direct = size > WINDOW_KEEP ? size - WINDOW_KEEP : 0;
+		commit(data, direct);
+		window.assign(data + direct, data + size);
+		return;
+	}
+
+	//Seeking ahead leaves 0's behind, same as a memory buffer
+	if (at + size > windowEnd) {
+		window.resize(at + size - windowStart);
+	}
+	memcpy(window.data() + (at - windowStart), data, size);
+
+	if (window.size() > WINDOW_SIZE) {
+		commitTo(windowStart + window.size() - WINDOW_KEEP);
+	}
+}
+
+void FileSink::patch(size_t at, const u8 *data, size_t size) {
+	if (at + size > windowStart) {
+		size_t inWindow = std::min(size, at + size - windowStart);
+		write(at + size - inWindow, data + size - inWindow, inWindow);
+		size -= inWindow;
+		if (size == 0) {
+			return;
+		}
+	}
+
+	if (isHashed(at, size)) {
+		throw SinkError("Patch at " + std::to_string(at) + " lands in bytes that were already hashed");
+	}
+
+	file.seekp(at);
+	file.write((const char*)data, size);
+	check("Patching", at);
+
+	size_t firstChunk = at / CRC_CHUNK_SIZE;
+	size_t lastChunk = (at + size - 1) / CRC_CHUNK_SIZE;
+	for (size_t c = firstChunk; c <= lastChunk; ++c) {
+		recomputeCrc(c);
+	}
+}
+
+void FileSink::beginHash(size_t at) {
+	if (hashing || at < windowStart) {
+		throw SinkError("Hash started at " + std::to_string(at) + ", behind what's been written");
+	}
+
+	hashing = true;
+	hashStart = at;
+	hash.reset();
+}
+
+void FileSink::endHash(size_t end, u8 *digest) {
+	if (!hashing || end < windowStart || end > windowStart + window.size()) {
+		throw SinkError("Hash ended at " + std::to_string(end) + ", outside of what's waiting to be written");
+	}
+
+	commitTo(end);
+
+	hash.finalize();
+	memcpy(digest, hash.digest, sizeof(hash.digest));
+
+	hashing = false;
+	hashedRanges.emplace_back(hashStart, end);
+}
+
+void FileSink::finish() {
+	if (hashing) {
+		throw SinkError("Finished in the middle of a hash");
+	}
+
+	commitTo(windowStart + window.size());
+	window.shrink_to_fit();
+
+	if (windowStart % CRC_CHUNK_SIZE != 0) {
+		chunkCrcs.push_back(currentCrc);
+	}
+
+	file.flush();
+	check("Flushing", windowStart);
+
+	file.close();
+	check("Closing", windowStart);
+}
+
+void FileSink::check(const char *what, size_t at) {
+	if (!file) {
+		throw SinkError(std::string(what) + " the file failed at " + std::to_string(at) + " (out of disk space?)");
+	}
+}
+
+void FileSink::commit(const u8 *data, size_t size) {
+	if (size == 0) {
+		return;
+	}
+
+	file.seekp(windowStart);
+	file.write((const char*)data, size);
+	check("Writing", windowStart);
+
+	if (hashing && windowStart + size > hashStart) {
+		size_t skip = hashStart > windowStart ? hashStart - windowStart : 0;
+		hash.update(data + skip, size - skip);
+	}
+
+	size_t done = 0;
+	while (done < size) {
+		size_t chunkPos = (windowStart + done) % CRC_CHUNK_SIZE;
+		size_t n = std::min(size - done, CRC_CHUNK_SIZE - chunkPos);
+		currentCrc = CRC::MemCrc32(data + done, (i32)n, currentCrc);
+		done += n;
+
+		if (chunkPos + n == CRC_CHUNK_SIZE) {
+			chunkCrcs.push_back(currentCrc);
+			currentCrc = 0;
+		}
+	}
+
+	windowStart += size;
+}
+
+void FileSink::commitTo(size_t pos) {
+	size_t n = pos - windowStart;
+	commit(window.data(), n);
+	window.erase(window.begin(), window.begin() + n);
+}
+
+void FileSink::readBack(size_t at, u8 *out, size_t size) {
+	file.seekg(at);
+	file.read((char*)out, size);
+	check("Reading back", at);
+}
+
+void FileSink::recomputeCrc(size_t chunk) {
+	size_t start = chunk * CRC_CHUNK_SIZE;
+	size_t end = std::min(start + CRC_CHUNK_SIZE, windowStart);
+
+	std::vector<u8> bytes(end - start);
+	readBack(start, bytes.data(), bytes.size());
+	u32 crc = CRC::MemCrc32(bytes.data(), (i32)bytes.size());
+
+	if (chunk < chunkCrcs.size()) {
+		chunkCrcs[chunk] = crc;
+	}
+	else {
+		currentCrc = crc;
+	}
+}
+
+bool FileSink::isHashed(size_t at, size_t size) {
+	if (hashing && at + size > hashStart) {
+		return true;
+	}
+
+	//Ranges are added in file order, so only the last one starting before the end can overlap
+	auto it = std::lower_bound(hashedRanges.begin(), hashedRanges.end(), std::make_pair(at + size, (size_t)0));
+	if (it == hashedRanges.begin()) {
+		return false;
+	}
+
+	--it;
+	return it->second > at;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "serialize.h"
+#include "sha1.h"
+
+#include <fstream>
+
+//Saves a DataBuffer straight to disk, only keeping a window of the most recent bytes in memory.
+//Bytes behind the window have been hashed and CRC'd already, so they can only change through patch().
+//Watched values are rewritten at finalize, so everything should be settled by a DataBuffer::measure() pass first.
+//Failed writes, and changes that would make a hash or CRC already worked out wrong, throw a SinkError.
+struct FileSink : DataSink {
+	static const size_t WINDOW_SIZE = 1024 * 1024;
+	static const size_t WINDOW_KEEP = 64 * 1024;
+	static const size_t CRC_CHUNK_SIZE = 64 * 1024;
+
+	//CRCs of every 64k chunk of the file, as used by .sig files. Complete after finish().
+	std::vector<u32> chunkCrcs;
+
+	bool open(const std::string &path);
+
+	void write(size_t at, const u8 *data, size_t size) override;
+	void patch(size_t at, const u8 *data, size_t size) override;
+	void beginHash(size_t at) override;
+	void endHash(size_t end, u8 *digest) override;
+	void finish() override;
+
+private:
+	std::fstream file;
+
+	std::vector<u8> window;
+	size_t windowStart = 0;
+
+	bool hashing = false;
+	size_t hashStart = 0;
+	SHA1 hash;
+	std::vector<std::pair<size_t, size_t>> hashedRanges;
+
+	u32 currentCrc = 0;
+
+	void check(const char *what, size_t at);
+	void commit(const u8 *data, size_t size);
+	void commitTo(size_t pos);
+	void readBack(size_t at, u8 *out, size_t size);
+	void recomputeCrc(size_t chunk);
+	bool isHashed(size_t at, size_t size);
+};
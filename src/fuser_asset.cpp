@@ -14,7 +14,10 @@ namespace fs = std::filesystem;
 #define NOMINMAX
 #include <Windows.h>
 
+#include "pak_reference_graph.h"
 #include "fuser_asset.h"
+#include "asset_catalog.h"
+#include "asset_diff.h"
 
 void replace(u8* data, size_t size, const std::string &find, const std::string &replace) {
 	if (find.size() != replace.size()) {
@@ -102,6 +105,7 @@ struct LogSection {
 
 struct DisplayPropertyCtx {
 	AssetHeader *header = nullptr;
+	PropertyArena *arena = nullptr;
 };
 DisplayPropertyCtx dispCtx;
 
@@ -126,7 +130,7 @@ void display_property(StringRef64& v) {
 }
 
 void display_property(UnknownProperty& v) {
-	ImGui::Text("Unknown Property (Length %d)", v.data);
+	ImGui::Text("Unknown Property (Length %zu)", v.data.size());
 }
 
 void display_property(BoolProperty& v) {
@@ -218,6 +222,18 @@ void display_property(ArrayProperty& v) {
 		ImGui::Dummy(ImVec2(0, 12));
 		++idx;
 	}
+
+	std::visit([&](auto &&elements) {
+		using T = std::decay_t<decltype(elements)>;
+		if constexpr (!std::is_same_v<T, std::monostate>) {
+			for (auto &&e : elements) {
+				ImSubregion r(idx);
+				display_property(e);
+				ImGui::Dummy(ImVec2(0, 12));
+				++idx;
+			}
+		}
+	}, v.typed);
 }
 
 void display_property(MapProperty& v) {
@@ -249,7 +265,7 @@ void display_property(PropertyData &v) {
 	if (ImGui::CollapsingHeader(name.c_str())) {
 		ImGui::Text("Type:"); ImGui::SameLine(); display_property(v.typeRef);
 		ImGui::Text("Length: %d", v.length);
-		display_property(v.value);
+		display_property(v.getValue(dispCtx.header, *dispCtx.arena));
 	}
 }
 
@@ -317,11 +333,15 @@ void display_category(HmxAssetFile &fusionAsset) {
 void display_asset(AssetData &assetData, AssetHeader *header) {
 	ImGui::PushID(&assetData);
 	dispCtx.header = header;
+	dispCtx.arena = &assetData.arena;
 
 	if (ImGui::CollapsingHeader("Names")) {
 		size_t i = 0;
 		for (auto &&n : header->names) {
-			ImGui::InputText(("Name[" + std::to_string(i) + "]").c_str(), &n.name);
+			std::string name = n.name;
+			if (ImGui::InputText(("Name[" + std::to_string(i) + "]").c_str(), &name)) {
+				header->setName((i32)i, name);
+			}
 			++i;
 		}
 	}
@@ -362,9 +382,71 @@ SaveFile f;
 
 PakFile pak;
 
+#ifdef DO_ASSET_FILE
+//Everything under template/ is listed from its header, an asset is only fully loaded once it's opened from the list
+AssetCatalog catalog;
+std::string catalogFilter;
+std::vector<const AssetSummary*> catalogResults;
+
+struct OpenedAsset {
+	std::string name;
+	Asset asset;
+};
+std::vector<std::unique_ptr<OpenedAsset>> assets;
+
+void open_asset(const AssetSummary &summary) {
+	auto assetFile = fs::path(summary.path);
+	auto uexpFile = assetFile.parent_path() / (assetFile.stem().string() + ".uexp");
+
+	std::ifstream infile(assetFile, std::ios_base::binary);
+	std::ifstream uexpfile(uexpFile, std::ios_base::binary);
+
+	std::vector<u8> fileData = std::vector<u8>(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+	fileData.insert(fileData.end(), std::istreambuf_iterator<char>(uexpfile), std::istreambuf_iterator<char>());
+
+	DataBuffer dataBuf;
+	dataBuf.setupVector(fileData);
+
+	auto opened = std::make_unique<OpenedAsset>();
+	opened->name = assetFile.stem().string();
+	dataBuf.serialize(opened->asset);
+	assets.emplace_back(std::move(opened));
+}
+
+void display_catalog() {
+	ImGui::Begin("Assets");
+
+	if (ImGui::InputText("Search", &catalogFilter)) {
+		catalogResults = catalog.search(catalogFilter);
+	}
+	ImGui::Text("%zu of %zu assets", catalogResults.size(), catalog.assets.size());
+
+	ImGuiListClipper clipper;
+	clipper.Begin((int)catalogResults.size());
+	while (clipper.Step()) {
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+			auto &&summary = *catalogResults[i];
+
+			ImGui::PushID(i);
+			if (ImGui::Selectable(summary.path.c_str())) {
+				open_asset(summary);
+			}
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip("%s", summary.ok ? (summary.exportClasses.empty() ? "" : summary.exportClasses[0].c_str()) : summary.error.c_str());
+			}
+			ImGui::PopID();
+		}
+	}
+
+	ImGui::End();
+}
+#endif
+
 void display_savefile(SaveFile &f) {
 	ImGui::Begin("Save File");
 
+	dispCtx.header = nullptr;
+	dispCtx.arena = &f.arena;
 	display_property(&f.properties);
 
 	ImGui::End();
@@ -536,32 +618,14 @@ void window_loop() {
 #endif
 
 		{
+			auto catalogPath = (fs::current_path() / "template_catalog.bin").string();
+			catalog.load(catalogPath);
+			size_t scanned = catalog.update((fs::current_path() / "template").string());
+			catalog.save(catalogPath);
 
-			for (auto& dirEntry : fs::recursive_directory_iterator(fs::current_path() / "template")) {
-				if (dirEntry.is_regular_file() && dirEntry.path().extension().string() == ".uasset") {
-					auto filename = dirEntry.path().stem().string();
-
-					auto assetFile = dirEntry.path();
-					auto uexpFile = dirEntry.path().parent_path() / (dirEntry.path().stem().string() + ".uexp");
-
-					std::ifstream infile(assetFile, std::ios_base::binary);
-					std::ifstream uexpfile(uexpFile, std::ios_base::binary);
-
-					std::vector<u8> fileData = std::vector<u8>(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
-					fileData.insert(fileData.end(), std::istreambuf_iterator<char>(uexpfile), std::istreambuf_iterator<char>());
-
-					DataBuffer dataBuf;
-					dataBuf.setupVector(fileData);
-
-					FuserAsset fuserAsset;
-					fuserAsset.name = filename;
-					dataBuf.serialize(fuserAsset.assetData);
-					assets.emplace_back(std::move(fuserAsset));
-				}
-			}
+			catalogResults = catalog.search(catalogFilter);
+			printf("%zu assets in template, %zu scanned\n", catalog.assets.size(), scanned);
 		}
-
-		auto &&a = assets.back();
 #endif
 
 #ifdef DO_SAVE_FILE
@@ -577,24 +641,27 @@ void window_loop() {
 
 #ifdef DO_PAK_FILE
 
-		{
-			std::ifstream infile("dllstar_template.pak", std::ios_base::binary);
-			std::vector<u8> fileData = std::vector<u8>(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+		if (auto file = MappedFile::open("dllstar_template.pak")) {
 			DataBuffer dataBuf;
-			dataBuf.setupVector(fileData);
+			dataBuf.setupSource(file);
 			dataBuf.serialize(pak);
 
 			std::vector<u8> outData;
 			DataBuffer outBuf;
-			outBuf.setupVector(outData);
-			outBuf.loading = false;
-			pak.serialize(outBuf);
+			outBuf.setupVectorFor(outData, pak);
+			outBuf.serialize(pak);
 			outBuf.finalize();
 
 			std::ofstream outPak("out.pak", std::ios_base::binary);
 			outPak.write((char*)outBuf.buffer, outBuf.size);
 
-			test_buffer(dataBuf, outBuf);
+			if (!test_buffer(dataBuf, outBuf)) {
+				PakFile resaved;
+				DataBuffer resavedBuf;
+				resavedBuf.setupVector(outData);
+				resavedBuf.serialize(resaved);
+				printDifferences(diffPaks(pak, resaved));
+			}
 
 
 			{
@@ -615,7 +682,7 @@ void window_loop() {
 				DataBuffer sigOutBuf;
 				sigOutBuf.setupVector(sigOutData);
 				sigOutBuf.loading = false;
-				sigFile.serialize(sigOutBuf);
+				sigOutBuf.serialize(sigFile);
 				sigOutBuf.finalize();
 
 				std::ofstream outPak("out.sig", std::ios_base::binary);
@@ -623,12 +690,14 @@ void window_loop() {
 			}
 
 		}
+		else {
+			printf("Couldn't open dllstar_template.pak\n");
+		}
 #endif
 
 #ifdef DO_SONG_CREATION
 		DataBuffer dataBuf;
-		dataBuf.buffer = (u8*)custom_song_pak_template;
-		dataBuf.size = sizeof(custom_song_pak_template);
+		dataBuf.setupSource(MappedFile::fromMemory(custom_song_pak_template, sizeof(custom_song_pak_template)));
 		dataBuf.serialize(songPakFile);
 
 		for (auto &&e : songPakFile.entries) {
@@ -660,9 +729,13 @@ void window_loop() {
 
 		printf("LOADING:\n\n");
 
+		PakReferenceGraph graph;
+		graph.build(songPakFile);
+
 		SongSerializationCtx ctx;
 		ctx.loading = true;
 		ctx.pak = &songPakFile;
+		ctx.graph = &graph;
 		mainFile.serialize(ctx);
 
 		//mainFile.shortName = "completely_different_short_name";
@@ -693,7 +766,7 @@ void window_loop() {
 		DataBuffer outBuf;
 		outBuf.setupVector(outData);
 		outBuf.loading = false;
-		songPakFile.serialize(outBuf);
+		outBuf.serialize(songPakFile);
 		outBuf.finalize();
 
 		std::ofstream outPak("out.pak", std::ios_base::binary);
@@ -774,14 +847,14 @@ void window_loop() {
 			std::vector<u8> cloneData;
 			entryCloneBuffer.setupVector(cloneData);
 
-			cat->entries[0].serialize(entryCloneBuffer);
+			entryCloneBuffer.serialize(cat->entries[0]);
 
 			DataTableCategory::Entry e = cat->entries[0];
 			e.value.values.clear();
 
 			entryCloneBuffer.pos = 0;
 			entryCloneBuffer.loading = true;
-			e.serialize(entryCloneBuffer);
+			entryCloneBuffer.serialize(e);
 			e.rowName = a.header.findOrCreateName("dornthisway");
 			std::get<NameProperty>(std::get<IPropertyDataList*>(e.value.values[0]->v)->get(a.header.findName("unlockName"))->value).name.ref = e.rowName.ref;
 			//std::get<EnumProperty>(std::get<IPropertyDataList*>(e.value.values[0]->v)->get(a.header.findName("unlockCategory"))->value).value = a.header.findOrCreateName("EUnlockCategory::DLC");
@@ -796,7 +869,7 @@ void window_loop() {
 		DataBuffer outBuf;
 		outBuf.setupVector(outData);
 		outBuf.loading = false;
-		assets.back().serialize(outBuf);
+		outBuf.serialize(assets.back());
 		outBuf.finalize();
 
 		//std::ofstream outAsset("D:/Mettra_User/Downloads/UnrealPakSwitchv6/UnrealPakSwitch/Fuser/Content/DLC/Songs/dornthisway/Meta_dornthisway.uasset", std::ios_base::binary);
@@ -841,8 +914,10 @@ void window_loop() {
 	}
 
 #ifdef DO_ASSET_FILE
+	display_catalog();
+
 	for (auto &&a : assets) {
-		display_asset(a);
+		display_asset(a->asset.data, &a->asset.header);
 	}
 #endif
 
@@ -871,9 +946,8 @@ void window_loop() {
 
 		std::vector<u8> outData;
 		DataBuffer outBuf;
-		outBuf.setupVector(outData);
-		outBuf.loading = false;
-		songPakFile.serialize(outBuf);
+		outBuf.setupVectorFor(outData, songPakFile);
+		outBuf.serialize(songPakFile);
 		outBuf.finalize();
 
 		DataBuffer testBuf;
@@ -903,7 +977,7 @@ void window_loop() {
 			DataBuffer sigOutBuf;
 			sigOutBuf.setupVector(sigOutData);
 			sigOutBuf.loading = false;
-			sigFile.serialize(sigOutBuf);
+			sigOutBuf.serialize(sigFile);
 			sigOutBuf.finalize();
 
 			std::ofstream outPak(basePath + mainFile.shortName + "_P.sig", std::ios_base::binary);
@@ -223,17 +223,55 @@ struct SongSerializationCtx {
 	PakFile *pak = nullptr;
 	PakFile::PakEntry *curEntry = nullptr;
 
+	//Built from pak before loading, links between its assets are followed through it
+	const PakReferenceGraph *graph = nullptr;
+
+	//Stems of asset entries by every trailing part of their path, for paths that aren't the whole entry name.
+	//Built on the first lookup that needs it, and dropped by renameFile. A suffix shared by several entries
+	//maps to nullptr, so which one comes back doesn't depend on the order of the entries.
+	std::unordered_map<std::string, PakFile::PakEntry*> suffixIndex;
 
 	PakFile::PakEntry *getFile(const std::string &fullPath) {
-		for (auto &&e : pak->entries) {
-			if (auto data = std::get_if<PakFile::PakEntry::PakAssetData>(&e.data)) {
-				if (e.name.find(fullPath) != std::string::npos) {
-					return &e;
+		if (auto e = pak->findEntry(fullPath + ".uexp")) {
+			if (std::holds_alternative<PakFile::PakEntry::PakAssetData>(e->data) || e->isPending()) {
+				return e;
+			}
+		}
+
+		if (suffixIndex.empty()) {
+			for (auto &&e : pak->entries) {
+				if (std::holds_alternative<PakFile::PakEntry::PakAssetData>(e.data) || (e.isPending() && e.name.find(".uexp") != std::string::npos)) {
+					std::string stem = e.name.substr(0, e.name.rfind('.'));
+					addSuffix(stem, &e);
+
+					for (auto slash = stem.find('/'); slash != std::string::npos; slash = stem.find('/', slash + 1)) {
+						addSuffix(stem.substr(slash + 1), &e);
+					}
 				}
 			}
 		}
 
-		return nullptr;
+		auto it = suffixIndex.find(fullPath);
+		return it != suffixIndex.end() ? it->second : nullptr;
+	}
+
+	//Moves an asset's .uexp and .uasset to path, keeping the lookups above right
+	void renameFile(PakFile::PakEntry &e, const std::string &path) {
+		pak->renameEntry(e, path + ".uexp");
+		pak->renameEntry(*std::get<PakFile::PakEntry::PakAssetData>(e.data).pakHeader, path + ".uasset");
+		suffixIndex.clear();
+	}
+
+	void addSuffix(const std::string &suffix, PakFile::PakEntry *e) {
+		auto inserted = suffixIndex.emplace(suffix, e);
+		if (!inserted.second && inserted.first->second != e) {
+			inserted.first->second = nullptr;
+		}
+	}
+
+	//The entry of the asset at a package path like /Game/Audio/Songs/x/x_bs
+	PakFile::PakEntry *getAsset(const std::string &packagePath) {
+		return graph->findEntry(packagePath);
 	}
 
 	AssetHeader &getHeader(PakFile::PakEntry *entry = nullptr) {
@@ -243,6 +281,12 @@ struct SongSerializationCtx {
 		return std::get<AssetHeader>(assetData.pakHeader->data);
 	}
 
+	AssetData &getAssetData(PakFile::PakEntry *entry = nullptr) {
+		if (entry == nullptr) entry = curEntry;
+
+		return std::get<PakFile::PakEntry::PakAssetData>(entry->data).data;
+	}
+
 	template<typename T>
 	T* getProp(PakFile::PakEntry *entry, const std::string &propName) {
 		auto &&assetData = std::get<PakFile::PakEntry::PakAssetData>(entry->data);
@@ -254,7 +298,7 @@ struct SongSerializationCtx {
 			return nullptr;
 		}
 
-		return &std::get<T>(v->value);
+		return &std::get<T>(v->getValue(header, assetData.data.arena));
 	}
 
 	template<typename T>
@@ -277,20 +321,20 @@ struct SongSerializationCtx {
 			prop.nameRef = header->findOrCreateName(propName);
 			prop.widgetData = 0;
 			prop.typeRef = header->findOrCreateName(asset_helper::getTypeForValue(v));
-			prop.value = std::move(v);
+			prop.setValue(std::move(v));
 			prop.length = sizeof(T);
 
 			obj.data.properties.emplace_back(std::move(prop));
 
 			NewProp<T> p;
 			p.propData = &obj.data.properties.back();
-			p.prop = &std::get<T>(obj.data.properties.back().value);
+			p.prop = &std::get<T>(obj.data.properties.back().getValue(header, assetData.data.arena));
 			return p;
 		}
 
 		NewProp<T> p;
 		p.propData = v;
-		p.prop = &std::get<T>(v->value);
+		p.prop = &std::get<T>(v->getValue(header, assetData.data.arena));
 		return p;
 	}
 
@@ -299,6 +343,32 @@ struct SongSerializationCtx {
 		return getProp<T>(curEntry, propName);
 	}
 
+	//Elements of an array property of T. Empty arrays are left out of the asset, so a missing one reads as empty.
+	//One holding something other than T is reported, and skipped.
+	template<typename T>
+	const std::vector<T> &getArray(PakFile::PakEntry *entry, const std::string &propName) {
+		static const std::vector<T> empty;
+
+		auto array = getProp<ArrayProperty>(entry, propName);
+		if (array == nullptr) {
+			return empty;
+		}
+
+		auto elements = array->view<T>();
+		if (elements == nullptr) {
+			printf("%s in %s isn't an array of the expected type, skipping it!\n", propName.c_str(), entry->name.c_str());
+			__debugbreak();
+			return empty;
+		}
+
+		return *elements;
+	}
+
+	template<typename T>
+	const std::vector<T> &getArray(const std::string &propName) {
+		return getArray<T>(curEntry, propName);
+	}
+
 	template<typename T>
 	NewProp<T> getOrCreateProp(const std::string &propName) {
 		return getOrCreateProp<T>(curEntry, propName);
@@ -310,7 +380,7 @@ struct SongSerializationCtx {
 			serializedStr = prop.name.getString(getHeader());
 		}
 		else {
-			getHeader().names[prop.name.ref].name = serializedStr;
+			getHeader().setName(prop.name.ref, serializedStr);
 		}
 	}
 
@@ -358,8 +428,6 @@ struct SongSerializationCtx {
 
 };
 
-static const std::string Game_Prefix = "/Game/";
-
 struct SongPakEntry {
 	PakFile::PakEntry *e = nullptr;
 	std::string path;
@@ -379,13 +447,12 @@ struct SongPakEntry {
 			path = parentPath + fileName;
 			name = fileName;
 
-			e->name = path + ".uexp";
-			std::get<PakFile::PakEntry::PakAssetData>(e->data).pakHeader->name = path + ".uasset";
+			ctx.renameFile(*e, path);
 
-			header.names[header.catagories[0].objectName].name = fileName;
+			header.setName(header.catagories[0].objectName, fileName);
 
 			if (thisObjectPath != -1) {
-				header.names[thisObjectPath].name = Game_Prefix + parentPath + fileName;
+				header.setName(thisObjectPath, Game_Prefix + parentPath + fileName);
 			}
 		}
 	}
@@ -403,7 +470,7 @@ struct FileLink {
 		if (ctx.loading) {
 
 			auto &&linkedFile = header.getLinkRef(header.getLinkRef(linkVal).link);
-			data.file.e = ctx.getFile(header.getHeaderRef(linkedFile.property).substr(Game_Prefix.size()) + ".uexp");
+			data.file.e = ctx.getAsset(header.getHeaderRef(linkedFile.property));
 		}
 
 		if (data.file.e == nullptr) return;
@@ -412,10 +479,10 @@ struct FileLink {
 		ctx.curEntry = prevFile;
 
 		if (!ctx.loading) {
-			ctx.getHeader().names[ctx.getHeader().getLinkRef(linkVal).property].name = fs::path(data.file.path).stem().string();
+			ctx.getHeader().setName(ctx.getHeader().getLinkRef(linkVal).property, fs::path(data.file.path).stem().string());
 
 			auto &&linkedFile = header.getLinkRef(header.getLinkRef(linkVal).link);
-			ctx.getHeader().names[linkedFile.property].name = Game_Prefix + data.file.path;
+			ctx.getHeader().setName(linkedFile.property, Game_Prefix + data.file.path);
 		}
 	}
 };
@@ -439,23 +506,18 @@ struct AssetLink {
 			std::string assetPath = fullPath.substr(0, pos);
 			hasExt = pos != std::string::npos;
 			if (hasExt) {
-				size_t idx = 0;
-				for (auto &&s : header.names) {
-					if (s.name == assetPath) {
-						refWithoutExtension = StringRef32();
-						refWithoutExtension->ref = idx;
-					}
-					++idx;
+				auto found = header.findName(assetPath);
+				if (found.ref != std::numeric_limits<i32>::max()) {
+					refWithoutExtension = found;
 				}
 			}
 			//std::string assetName = fullPath.substr(pos + 1);
-			data.file.e = ctx.getFile(assetPath.substr(Game_Prefix.size()) + ".uexp");
+			data.file.e = ctx.getAsset(assetPath);
 
-			for (auto &&l : header.links) {
-				if (l.link != 0 && header.names[header.getLinkRef(l.link).property].name == assetPath) {
-					shortRef = StringRef32();
-					shortRef->ref = l.property;
-				}
+			auto reference = ctx.graph->findReference(ctx.curEntry, assetPath);
+			if (reference != nullptr && reference->objectLink != -1) {
+				shortRef = StringRef32();
+				shortRef->ref = header.links[reference->objectLink].property;
 			}
 		}
 
@@ -472,17 +534,17 @@ struct AssetLink {
 
 			//@TODO: Another special case for beats
 			if (refWithoutExtension) {
-				header.names[refWithoutExtension->ref].name = assetPath;
+				header.setName(refWithoutExtension->ref, assetPath);
 			}
 
 			if (hasExt) {
 				assetPath += "." + subHeader.getHeaderRef(subHeader.catagories[0].objectName);
 			}
-			header.names[ref.ref].name = assetPath;
+			header.setName(ref.ref, assetPath);
 
 			if (shortRef.has_value()) {
 				std::string shortName = assetPath.substr(assetPath.find_last_of('/') + 1);
-				header.names[shortRef->ref].name = shortName;
+				header.setName(shortRef->ref, shortName);
 			}
 		}
 	}
@@ -576,14 +638,14 @@ struct MidiSongAsset {
 			midiPath = midiPath.substr(0, midiPath.find_first_of('.'));
 
 			auto &&header = file.e->getData().pakHeader->getHeader();
-			for (auto &&l : header.links) {
-				if (header.getHeaderRef(l.property) == fusionPath) {
-					fusionFile.ref.ref = l.property;
-				}
+			auto fusionRef = ctx.graph->findReference(file.e, fusionPath);
+			if (fusionRef != nullptr && fusionRef->kind == PakReferenceGraph::Kind::Import) {
+				fusionFile.ref.ref = header.links[fusionRef->packageLink].property;
+			}
 
-				if (header.getHeaderRef(l.property) == midiPath) {
-					midiFile.ref.ref = l.property;
-				}
+			auto midiRef = ctx.graph->findReference(file.e, midiPath);
+			if (midiRef != nullptr && midiRef->kind == PakReferenceGraph::Kind::Import) {
+				midiFile.ref.ref = header.links[midiRef->packageLink].property;
 			}
 
 		}
@@ -623,18 +685,18 @@ struct SongTransition {
 		ctx.serializeName("ShortName", shortName);
 
 		if (ctx.loading) {
-			for (auto &&v : ctx.getProp<ArrayProperty>("MajorMidiSongAssets")->values) {
+			for (auto &&v : ctx.getArray<SoftObjectProperty>("MajorMidiSongAssets")) {
 				AssetLink<MidiSongAsset> midiAsset;
-				midiAsset.ref = std::get<SoftObjectProperty>(v->v).name;
+				midiAsset.ref = v.name;
 				midiAsset.data.major = true;
 				midiAsset.serialize(ctx);
 				majorAssets.emplace_back(std::move(midiAsset));
 			}
 
 			if (ctx.curType.value != CelType::Type::Beat) {
-				for (auto &&v : ctx.getProp<ArrayProperty>("MinorMidiSongAssets")->values) {
+				for (auto &&v : ctx.getArray<SoftObjectProperty>("MinorMidiSongAssets")) {
 					AssetLink<MidiSongAsset> midiAsset;
-					midiAsset.ref = std::get<SoftObjectProperty>(v->v).name;
+					midiAsset.ref = v.name;
 					midiAsset.data.major = false;
 					midiAsset.serialize(ctx);
 					minorAssets.emplace_back(std::move(midiAsset));
@@ -720,9 +782,9 @@ struct CelData {
 		songTransitionFile.serialize(ctx);
 
 		if (ctx.loading) {
-			for (auto &&v : ctx.getProp<ArrayProperty>("MajorMidiSongAssets")->values) {
+			for (auto &&v : ctx.getArray<SoftObjectProperty>("MajorMidiSongAssets")) {
 				AssetLink<MidiSongAsset> midiAsset;
-				midiAsset.ref = std::get<SoftObjectProperty>(v->v).name;
+				midiAsset.ref = v.name;
 				midiAsset.data.major = true;
 				midiAsset.serialize(ctx);
 				majorAssets.emplace_back(std::move(midiAsset));
@@ -730,9 +792,9 @@ struct CelData {
 
 			//@TODO: Another special case for beats
 			if (ctx.curType.value != CelType::Type::Beat) {
-				for (auto &&v : ctx.getProp<ArrayProperty>("MinorMidiSongAssets")->values) {
+				for (auto &&v : ctx.getArray<SoftObjectProperty>("MinorMidiSongAssets")) {
 					AssetLink<MidiSongAsset> midiAsset;
-					midiAsset.ref = std::get<SoftObjectProperty>(v->v).name;
+					midiAsset.ref = v.name;
 					midiAsset.data.major = false;
 					midiAsset.serialize(ctx);
 					minorAssets.emplace_back(std::move(midiAsset));
@@ -762,14 +824,17 @@ struct CelData {
 			{
 				struct Transpose {
 					PropertyData *data;
+					IPropertyDataList *list;
 				};
 				std::vector<Transpose> tpose;
 
 				auto&& transposes = *ctx.getProp<StructProperty>("Transposes");
 				for (auto &&v : transposes.values) {
-					for (auto &&p : std::get<IPropertyDataList*>(v->v)->properties) {
+					auto list = std::get<IPropertyDataList*>(v->v);
+					for (auto &&p : list->properties) {
 						Transpose t;
 						t.data = &p;
+						t.list = list;
 						tpose.emplace_back(std::move(t));
 					}
 				}
@@ -808,7 +873,7 @@ struct CelData {
 							}
 						}
 
-						p.data->nameRef = ctx.getHeader().findOrCreateName(keyValues[missingValue].substr(sizeof("EKey::") - 1));
+						p.list->rename(*p.data, ctx.getHeader().findOrCreateName(keyValues[missingValue].substr(sizeof("EKey::") - 1)));
 						break;
 					}
 				}
@@ -825,7 +890,7 @@ struct CelData {
 					else if (offset >= 6) {
 						offset -= 12;
 					}
-					std::get<PrimitiveProperty<i32>>(p.data->value).data = offset;
+					std::get<PrimitiveProperty<i32>>(p.data->getValue(&ctx.getHeader(), ctx.getAssetData().arena)).data = offset;
 				}
 
 			}
@@ -871,10 +936,9 @@ struct AssetRoot {
 		ctx.serializeText("Artist", artistName);
 
 		if (ctx.loading) {
-			auto &celArray = *ctx.getProp<ArrayProperty>(file.e, "Cels");
-			for (auto &&v : celArray.values) {
+			for (auto &&v : ctx.getArray<ObjectProperty>(file.e, "Cels")) {
 				FileLink<CelData> fileLink;
-				fileLink.linkVal = std::get<ObjectProperty>(v->v).linkVal;
+				fileLink.linkVal = v.linkVal;
 				fileLink.serialize(ctx);
 
 				if (fileLink.data.type.value != CelType::Type::Beat) {
@@ -2,7 +2,8 @@
 #include <sstream>
 #include <iomanip>
 
-void hmx_array::serialize(DataBuffer &buffer) {
+template<typename P>
+void hmx_array::serialize(PolicyBuffer<P> &buffer) {
 	numChildren = children.size();
 
 	buffer.serialize(nodeId);
@@ -11,7 +12,8 @@ void hmx_array::serialize(DataBuffer &buffer) {
 	buffer.serializeWithSize(children, numChildren);
 }
 
-void hmx_subtree_node::serialize(DataBuffer &buffer) {
+template<typename P>
+void hmx_subtree_node::serialize(PolicyBuffer<P> &buffer) {
 	numChildren = children.size();
 
 	buffer.serialize(numChildren);
@@ -19,6 +21,16 @@ void hmx_subtree_node::serialize(DataBuffer &buffer) {
 	buffer.serializeWithSize(children, numChildren);
 }
 
+template void hmx_array::serialize(ReadBuffer &);
+template void hmx_array::serialize(SizeBuffer &);
+template void hmx_array::serialize(WriteBuffer &);
+template void hmx_array::serialize(SinkBuffer &);
+
+template void hmx_subtree_node::serialize(ReadBuffer &);
+template void hmx_subtree_node::serialize(SizeBuffer &);
+template void hmx_subtree_node::serialize(WriteBuffer &);
+template void hmx_subtree_node::serialize(SinkBuffer &);
+
 
 hmx_fusion_node::~hmx_fusion_node() {
 	//if (auto node = std::get_if<hmx_fusion_nodes*>(&value)) {
@@ -27,25 +39,43 @@ hmx_fusion_node::~hmx_fusion_node() {
 }
 
 hmx_fusion_nodes hmx_fusion_parser::parseData(const std::vector<u8> &fusion_file) {
-	const u8 *b = fusion_file.data();
+	return parseData(fusion_file.data(), fusion_file.size());
+}
+
+hmx_fusion_nodes hmx_fusion_parser::parseData(const u8 *data, size_t size, bool throwOnError) {
+	const u8 *b = data;
+	const u8 *end = data + size;
 	hmx_fusion_nodes nodes;
 
+	auto fail = [&](const std::string &message) {
+		if (throwOnError) {
+			throw ParseError(message, b - data);
+		}
+
+		__debugbreak();
+	};
+
+	//Reads as 0 past the end, which none of the checks below accept
+	auto peek = [&]() -> u8 {
+		return b < end ? *b : 0;
+	};
+
 	auto consume = [&](char c) {
-		if (*b == c) {
+		if (peek() == c) {
 			++b;
 		}
 		else {
-			__debugbreak();
+			fail(std::string("Expected '") + c + "' in fusion file");
 		}
 	};
 
 	auto skip_whitespace = [&]() {
-		while (isspace(*b)) { ++b; }
+		while (isspace(peek())) { ++b; }
 	};
 
 	auto get_name = [&]() {
 		std::string name;
-		while (!isspace(*b)) {
+		while (b < end && !isspace(*b)) {
 			name += *b;
 			++b;
 		}
@@ -57,7 +87,7 @@ hmx_fusion_nodes hmx_fusion_parser::parseData(const std::vector<u8> &fusion_file
 		std::string str;
 		
 		consume('"');
-		while (*b != '"') {
+		while (b < end && *b != '"') {
 			str += *b;
 			++b;
 		}
@@ -71,7 +101,7 @@ hmx_fusion_nodes hmx_fusion_parser::parseData(const std::vector<u8> &fusion_file
 
 		std::string number;
 		bool has_dot = false;
-		while ((*b >= '0' && *b <= '9') || *b == '.' || *b == '-') {
+		while ((peek() >= '0' && peek() <= '9') || peek() == '.' || peek() == '-') {
 			number += *b;
 			if (*b == '.') {
 				has_dot = true;
@@ -79,6 +109,11 @@ hmx_fusion_nodes hmx_fusion_parser::parseData(const std::vector<u8> &fusion_file
 			++b;
 		}
 
+		if (number.empty() || number == "-" || number == ".") {
+			fail("Expected a number in fusion file");
+			return value;
+		}
+
 		if (has_dot) {
 			value = std::stof(number);
 		}
@@ -98,9 +133,9 @@ hmx_fusion_nodes hmx_fusion_parser::parseData(const std::vector<u8> &fusion_file
 		skip_whitespace();
 
 		//Sub-Object
-		if (*b == '(') {
+		if (peek() == '(') {
 			hmx_fusion_nodes* nodes = new hmx_fusion_nodes();
-			while (*b == '(') {
+			while (peek() == '(') {
 				nodes->children.emplace_back(parse_node());
 				skip_whitespace();
 			}
@@ -108,15 +143,19 @@ hmx_fusion_nodes hmx_fusion_parser::parseData(const std::vector<u8> &fusion_file
 			node.value = std::move(nodes);
 		}
 		//String
-		else if (*b == '"') {
+		else if (peek() == '"') {
 			node.value = get_string();
 		}
 		//Number or vector
 		else {
 			auto num = get_number();
 			skip_whitespace();
-			if (*b != ')') {
+			if (peek() != ')') {
 				auto num2 = get_number();
+				if (!std::holds_alternative<float>(num) || !std::holds_alternative<float>(num2)) {
+					fail("Expected a vector of two floats in fusion file");
+					return node;
+				}
 
 				hmx_vec v;
 				v.x = std::get<float>(num);
@@ -133,7 +172,7 @@ hmx_fusion_nodes hmx_fusion_parser::parseData(const std::vector<u8> &fusion_file
 		return node;
 	};
 
-	while ((b - fusion_file.data()) < fusion_file.size()) {
+	while ((size_t)(b - data) < size) {
 		nodes.children.emplace_back(parse_node());
 		skip_whitespace();
 	}
@@ -47,6 +47,8 @@ struct hmx_fusion_nodes {
 
 struct hmx_fusion_parser {
 	static hmx_fusion_nodes parseData(const std::vector<u8> &fusion_file);
+	//With throwOnError, malformed text throws a ParseError with an offset into data instead of breaking into the debugger
+	static hmx_fusion_nodes parseData(const u8 *data, size_t size, bool throwOnError = false);
 	static std::string outputData(const hmx_fusion_nodes &nodes);
 };
 
@@ -57,7 +59,8 @@ struct hmx_array {
 	u16 unk;
 	std::vector<hmx_node> children;
 
-	void serialize(DataBuffer &buffer);
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer);
 };
 
 struct hmx_subtree_node {
@@ -65,13 +68,15 @@ struct hmx_subtree_node {
 	i32 nodeId;
 	std::vector<hmx_node> children;
 
-	void serialize(DataBuffer &buffer);
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer);
 };
 
 struct hmx_string {
 	std::string str;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		i32 size = str.size();
 		buffer.serialize(size);
 		str.resize(size);
@@ -110,7 +115,8 @@ struct hmx_node {
 		return std::get<hmx_string>(value);
 	}
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(type);
 
 		if (buffer.loading) {
@@ -0,0 +1,117 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string &path) {
+	auto file = std::make_shared<MappedFile>();
+	file->path = path;
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	file->fileHandle = handle;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize)) {
+		return nullptr;
+	}
+	file->length = (size_t)fileSize.QuadPart;
+
+	//Zero length files can't be mapped, but are still valid to open
+	if (file->length == 0) {
+		return file;
+	}
+
+	HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		return nullptr;
+	}
+	file->mappingHandle = mapping;
+
+	file->ptr = (const u8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (file->ptr == nullptr) {
+		return nullptr;
+	}
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return nullptr;
+	}
+	file->fileHandle = (void*)(intptr_t)(fd + 1);
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		return nullptr;
+	}
+	file->length = (size_t)st.st_size;
+
+	if (file->length == 0) {
+		return file;
+	}
+
+	void *p = mmap(nullptr, file->length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		return nullptr;
+	}
+	file->ptr = (const u8*)p;
+#endif
+
+	file->mapped = true;
+	return file;
+}
+
+std::shared_ptr<MappedFile> MappedFile::fromMemory(const u8 *data, size_t size) {
+	auto file = std::make_shared<MappedFile>();
+	file->ptr = data;
+	file->length = size;
+	return file;
+}
+
+MappedFile::~MappedFile() {
+	unmap();
+}
+
+void MappedFile::detach() {
+	if (!mapped && fileHandle == nullptr) {
+		return;
+	}
+
+	detached.assign(ptr, ptr + length);
+	unmap();
+	ptr = detached.data();
+}
+
+void MappedFile::unmap() {
+#ifdef _WIN32
+	if (mapped && ptr) {
+		UnmapViewOfFile(ptr);
+	}
+	if (mappingHandle) {
+		CloseHandle((HANDLE)mappingHandle);
+	}
+	if (fileHandle) {
+		CloseHandle((HANDLE)fileHandle);
+	}
+#else
+	if (mapped && ptr) {
+		munmap((void*)ptr, length);
+	}
+	if (fileHandle) {
+		::close((int)(intptr_t)fileHandle - 1);
+	}
+#endif
+
+	mapped = false;
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "core_types.h"
+
+#include <memory>
+
+//Read-only view of a whole file mapped into memory.
+//Also used to wrap memory that's already resident (like the embedded template), so both can be loaded the same way.
+struct MappedFile {
+	std::string path;
+
+	static std::shared_ptr<MappedFile> open(const std::string &path);
+	static std::shared_ptr<MappedFile> fromMemory(const u8 *data, size_t size);
+
+	~MappedFile();
+
+	const u8* data() const {
+		return ptr;
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+	//Copies the contents into memory and releases the OS mapping.
+	//Needed before overwriting the file we were loaded from, since a mapped file can't be truncated.
+	void detach();
+
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+	const u8 *ptr = nullptr;
+	size_t length = 0;
+	std::vector<u8> detached;
+
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+	bool mapped = false;
+
+	void unmap();
+};
+
+//Byte payload that is either owned, or a read-only view into the file it was parsed from.
+//Views are only made when loading from a MappedFile, and keep that file alive.
+struct DataBlob {
+	DataBlob() {}
+	DataBlob(std::vector<u8> &&v) : owned(std::move(v)) {}
+
+	DataBlob& operator=(std::vector<u8> &&v) {
+		owned = std::move(v);
+		source.reset();
+		offset = 0;
+		viewSize = 0;
+		return *this;
+	}
+
+	void setView(std::shared_ptr<MappedFile> file, size_t fileOffset, size_t size) {
+		owned.clear();
+		owned.shrink_to_fit();
+		source = std::move(file);
+		offset = fileOffset;
+		viewSize = size;
+	}
+
+	bool isView() const {
+		return source != nullptr;
+	}
+
+	//The file a view is into, null for owned bytes
+	const std::shared_ptr<MappedFile>& viewSource() const {
+		return source;
+	}
+
+	const u8* data() const {
+		return source ? source->data() + offset : owned.data();
+	}
+
+	size_t size() const {
+		return source ? viewSize : owned.size();
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	std::vector<u8> toVector() const {
+		return std::vector<u8>(data(), data() + size());
+	}
+
+	//Turns a view into an owned copy, so the bytes can be edited
+	std::vector<u8>& getMutable() {
+		if (source) {
+			owned = toVector();
+			source.reset();
+			offset = 0;
+			viewSize = 0;
+		}
+
+		return owned;
+	}
+
+private:
+	std::vector<u8> owned;
+	std::shared_ptr<MappedFile> source;
+	size_t offset = 0;
+	size_t viewSize = 0;
+};
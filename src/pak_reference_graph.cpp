@@ -0,0 +1,220 @@
+#include "pak_reference_graph.h"
+
+//Everything before the object name, /Game/x/y.y is in package /Game/x/y
+static std::string packageOf(const std::string &path) {
+	return path.substr(0, path.find_first_of('.'));
+}
+
+struct SoftObjectFinder {
+	AssetHeader &header;
+	PropertyArena &arena;
+	std::vector<std::string> paths;
+
+	SoftObjectFinder(AssetHeader &header, PropertyArena &arena) : header(header), arena(arena) {}
+
+	template<typename T>
+	void visit(T &) {}
+
+	void visit(SoftObjectProperty &v) {
+		paths.emplace_back(v.name.getString(header));
+	}
+
+	void visit(IPropertyValue *v) {
+		visit(v->v);
+	}
+
+	void visit(ArrayProperty &v) {
+		for (auto &&e : v.values) {
+			visit(e);
+		}
+
+		if (auto softObjects = v.view<SoftObjectProperty>()) {
+			for (auto &&e : *softObjects) {
+				visit(e);
+			}
+		}
+	}
+
+	void visit(MapProperty &v) {
+		for (auto &&pair : v.map) {
+			visit(pair.key);
+			visit(pair.value);
+		}
+	}
+
+	void visit(StructProperty &v) {
+		for (auto &&e : v.values) {
+			visit(e);
+		}
+	}
+
+	//Deferred values that can hold a soft object are decoded into a scratch copy, so they're still saved verbatim
+	void visit(PropertyData &v) {
+		if (!v.isRaw()) {
+			visit(v.getValue(&header, arena));
+			return;
+		}
+
+		auto &&type = v.typeRef.getString(header);
+		if (type != "SoftObjectProperty" && type != "ArrayProperty" && type != "MapProperty" && type != "StructProperty") {
+			return;
+		}
+
+		PropertyArena scratch;
+		auto value = v.decodeRaw(&header, scratch);
+		visit(value);
+	}
+
+	void visit(IPropertyDataList *v) {
+		for (auto &&p : v->properties) {
+			visit(p);
+		}
+	}
+
+	void visit(asset_helper::PropertyValue &v) {
+		std::visit([&](auto &&value) {
+			visit(value);
+		}, v);
+	}
+
+	void visit(UObject &v) {
+		visit(&v.data);
+	}
+
+	void visit(DataTableCategory &v) {
+		visit(&v.base.data);
+		for (auto &&e : v.entries) {
+			visit(e.value);
+		}
+	}
+
+	void visit(HmxAssetFile &v) {
+		visit(&v.propList);
+	}
+};
+
+void PakReferenceGraph::build(PakFile &pak) {
+	assets.clear();
+	references.clear();
+	byPath.clear();
+	byEntry.clear();
+	byPair.clear();
+
+	pak.loadEntries();
+
+	//Every asset in the pak goes in first, so a reference lands on its entry whatever order the entries are in
+	for (auto &&e : pak.entries) {
+		if (std::holds_alternative<PakFile::PakEntry::PakAssetData>(e.data)) {
+			size_t idx = getOrAddAsset(Game_Prefix + e.name.substr(0, e.name.rfind('.')));
+			assets[idx].entry = &e;
+			byEntry[&e] = idx;
+		}
+	}
+
+	for (auto &&e : pak.entries) {
+		auto data = std::get_if<PakFile::PakEntry::PakAssetData>(&e.data);
+		if (data == nullptr) {
+			continue;
+		}
+
+		size_t from = byEntry[&e];
+		auto &&header = e.getHeader();
+
+		//Package imports are the outermost ones, what's imported from a package has it as its outer
+		std::unordered_map<i32, i32> objectLinks;
+		for (i32 i = 0; i < (i32)header.links.size(); ++i) {
+			auto &&l = header.links[i];
+			if (l.link < 0) {
+				objectLinks[-l.link - 1] = i;
+			}
+		}
+
+		for (i32 i = 0; i < (i32)header.links.size(); ++i) {
+			auto &&l = header.links[i];
+			if (l.link == 0) {
+				auto object = objectLinks.find(i);
+				addReference(from, getOrAddAsset(header.getHeaderRef(l.property)), Kind::Import, i, object != objectLinks.end() ? object->second : -1);
+			}
+		}
+
+		SoftObjectFinder finder(header, data->data.arena);
+		for (auto &&c : data->data.catagoryValues) {
+			std::visit([&](auto &&v) {
+				finder.visit(v);
+			}, c.value);
+		}
+
+		for (auto &&path : finder.paths) {
+			if (!path.empty()) {
+				addReference(from, getOrAddAsset(packageOf(path)), Kind::SoftObject);
+			}
+		}
+
+		for (auto &&c : data->data.catagoryValues) {
+			if (auto hmx = std::get_if<HmxAssetFile>(&c.value)) {
+				for (auto &&file : hmx->audio.audioFiles) {
+					if (auto midiMusic = std::get_if<HmxAudio::PackageFile::MidiMusicResource>(&file.resourceHeader)) {
+						for (auto &&path : { &midiMusic->midisong_engine_path, &midiMusic->mid_engine_path, &midiMusic->patch_engine_path }) {
+							if (!path->str.empty()) {
+								addReference(from, getOrAddAsset(packageOf(path->str)), Kind::EnginePath);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+size_t PakReferenceGraph::getOrAddAsset(const std::string &path) {
+	auto it = byPath.find(path);
+	if (it != byPath.end()) {
+		return it->second;
+	}
+
+	size_t idx = assets.size();
+	assets.emplace_back().path = path;
+	byPath.emplace(path, idx);
+	return idx;
+}
+
+void PakReferenceGraph::addReference(size_t from, size_t to, Kind kind, i32 packageLink, i32 objectLink) {
+	//A midisong names itself among its engine paths
+	if (from == to) {
+		return;
+	}
+
+	size_t idx = references.size();
+	references.emplace_back(Reference{ from, to, kind, packageLink, objectLink });
+	assets[from].references.emplace_back(idx);
+	assets[to].referencedBy.emplace_back(idx);
+
+	//Imports are added first, so they're the ones kept for a pair
+	byPair.emplace(((u64)from << 32) | (u64)to, idx);
+}
+
+const PakReferenceGraph::Asset* PakReferenceGraph::find(const std::string &path) const {
+	auto it = byPath.find(path);
+	return it != byPath.end() ? &assets[it->second] : nullptr;
+}
+
+const PakReferenceGraph::Asset* PakReferenceGraph::find(const PakFile::PakEntry *entry) const {
+	auto it = byEntry.find(entry);
+	return it != byEntry.end() ? &assets[it->second] : nullptr;
+}
+
+PakFile::PakEntry* PakReferenceGraph::findEntry(const std::string &path) const {
+	auto asset = find(path);
+	return asset != nullptr ? asset->entry : nullptr;
+}
+
+const PakReferenceGraph::Reference* PakReferenceGraph::findReference(const PakFile::PakEntry *from, const std::string &path) const {
+	auto fromIt = byEntry.find(from);
+	auto toIt = byPath.find(path);
+	if (fromIt == byEntry.end() || toIt == byPath.end()) {
+		return nullptr;
+	}
+
+	auto it = byPair.find(((u64)fromIt->second << 32) | (u64)toIt->second);
+	return it != byPair.end() ? &references[it->second] : nullptr;
+}
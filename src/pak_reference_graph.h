@@ -0,0 +1,58 @@
+#pragma once
+#include "core_types.h"
+#include "uasset.h"
+
+#include <unordered_map>
+
+//Which assets of a pak refer to which other assets, worked out once after the pak is loaded so following a link
+//doesn't mean searching every entry and name for a path. Assets are keyed by package path, like /Game/Audio/Songs/x/x_bs.
+//Packages referred to that aren't in the pak (engine classes, shared content) are in here too, without an entry.
+//Renaming entries or names leaves it stale, build it again after.
+struct PakReferenceGraph {
+	enum class Kind {
+		Import,      //A package import in the header
+		SoftObject,  //A SoftObjectProperty anywhere in the properties
+		EnginePath   //A path in a MidiMusicResource
+	};
+
+	struct Reference {
+		size_t from;
+		size_t to;
+		Kind kind;
+
+		//Imports only. The package import in the header of from, and the last import whose outer it is.
+		i32 packageLink = -1;
+		i32 objectLink = -1;
+	};
+
+	struct Asset {
+		std::string path;
+		PakFile::PakEntry *entry = nullptr;
+
+		//Indices into references
+		std::vector<size_t> references;
+		std::vector<size_t> referencedBy;
+	};
+
+	std::vector<Asset> assets;
+	std::vector<Reference> references;
+
+	void build(PakFile &pak);
+
+	const Asset* find(const std::string &path) const;
+	const Asset* find(const PakFile::PakEntry *entry) const;
+
+	//The entry of the asset at path, if it's in the pak
+	PakFile::PakEntry* findEntry(const std::string &path) const;
+
+	//How from refers to the asset at path. Imports win over any other kind of reference.
+	const Reference* findReference(const PakFile::PakEntry *from, const std::string &path) const;
+
+private:
+	std::unordered_map<std::string, size_t> byPath;
+	std::unordered_map<const PakFile::PakEntry*, size_t> byEntry;
+	std::unordered_map<u64, size_t> byPair;
+
+	size_t getOrAddAsset(const std::string &path);
+	void addReference(size_t from, size_t to, Kind kind, i32 packageLink = -1, i32 objectLink = -1);
+};
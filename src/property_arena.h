@@ -0,0 +1,145 @@
+#pragma once
+#include "core_types.h"
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//Owns every node of a parsed property tree. Nodes are carved out of large blocks, and are all destroyed
+//and freed together with the arena instead of being new'd and deleted one at a time.
+//Moving an arena keeps its nodes where they are, so whatever owns it can still be moved after loading.
+struct PropertyArena {
+	static const size_t BLOCK_SIZE = 64 * 1024;
+
+	PropertyArena() {}
+	PropertyArena(const PropertyArena&) = delete;
+	PropertyArena& operator=(const PropertyArena&) = delete;
+
+	PropertyArena(PropertyArena &&rhs) {
+		*this = std::move(rhs);
+	}
+
+	PropertyArena& operator=(PropertyArena &&rhs) {
+		if (this != &rhs) {
+			clear();
+			blocks = std::move(rhs.blocks);
+			firstNode = rhs.firstNode;
+			lastNode = rhs.lastNode;
+			created = rhs.created;
+
+			rhs.blocks.clear();
+			rhs.firstNode = nullptr;
+			rhs.lastNode = nullptr;
+			rhs.created = 0;
+		}
+		return *this;
+	}
+
+	~PropertyArena() {
+		clear();
+	}
+
+	template<typename T, typename... Args>
+	T* create(Args&&... args) {
+		static_assert(alignof(T) <= alignof(std::max_align_t), "Over aligned types aren't supported");
+
+		//Each node is preceded by a link back to the one before it, so destruction needs no list of its own
+		u8 *mem = (u8*)allocate(sizeof(NodeHeader) + sizeof(T));
+		T *ptr = new (mem + sizeof(NodeHeader)) T(std::forward<Args>(args)...);
+
+		auto header = (NodeHeader*)mem;
+		header->prev = lastNode;
+		header->destroy = [](void *p) { ((T*)p)->~T(); };
+		if (!firstNode) {
+			firstNode = header;
+		}
+		lastNode = header;
+
+		++created;
+		return ptr;
+	}
+
+	//Takes over every node of other, leaving it empty. Lets separate arenas be filled on separate threads and combined afterwards.
+	void merge(PropertyArena &&other) {
+		if (this == &other || !other.lastNode) {
+			return;
+		}
+
+		other.firstNode->prev = lastNode;
+		if (!firstNode) {
+			firstNode = other.firstNode;
+		}
+		lastNode = other.lastNode;
+		created += other.created;
+
+		for (auto &&b : other.blocks) {
+			blocks.emplace_back(std::move(b));
+		}
+
+		other.blocks.clear();
+		other.firstNode = nullptr;
+		other.lastNode = nullptr;
+		other.created = 0;
+	}
+
+	size_t objectCount() const {
+		return created;
+	}
+
+	size_t blockCount() const {
+		return blocks.size();
+	}
+
+private:
+	struct alignas(std::max_align_t) NodeHeader {
+		NodeHeader *prev;
+		void (*destroy)(void*);
+	};
+
+	struct Block {
+		std::unique_ptr<u8[]> data;
+		size_t used = 0;
+		size_t capacity = 0;
+	};
+	std::vector<Block> blocks;
+	NodeHeader *firstNode = nullptr;
+	NodeHeader *lastNode = nullptr;
+	size_t created = 0;
+
+	void* allocate(size_t size) {
+		const size_t align = alignof(std::max_align_t);
+		size = (size + align - 1) & ~(align - 1);
+
+		if (!blocks.empty()) {
+			auto &&b = blocks.back();
+			if (b.used + size <= b.capacity) {
+				void *ptr = b.data.get() + b.used;
+				b.used += size;
+				return ptr;
+			}
+		}
+
+		//Anything bigger than a block gets a block of its own
+		Block b;
+		b.capacity = size > BLOCK_SIZE ? size : BLOCK_SIZE;
+		b.data.reset(new u8[b.capacity]);
+		b.used = size;
+
+		void *ptr = b.data.get();
+		blocks.emplace_back(std::move(b));
+		return ptr;
+	}
+
+	void clear() {
+		for (auto node = lastNode; node; node = node->prev) {
+			node->destroy((u8*)node + sizeof(NodeHeader));
+		}
+
+		firstNode = nullptr;
+		lastNode = nullptr;
+		blocks.clear();
+		created = 0;
+	}
+};
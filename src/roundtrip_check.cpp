@@ -0,0 +1,334 @@
+//Headless round-trip check over a folder of paks and uassets. Every file is loaded, saved back out and compared
+//byte for byte with what it was loaded from, on a pool of workers. Built as its own console target, see CMakeLists.txt.
+//
+//	roundtrip_check <directory> [--threads N] [--csv results.csv]
+//	roundtrip_check --template [--runs N]
+//
+//--template times the embedded song template instead, for checking a serializer change pays off.
+//Exits with 1 if any file failed to load or didn't save back identically.
+
+#include "uasset.h"
+#include "asset_scan.h"
+#include "asset_diff.h"
+#include "thread_pool.h"
+#include "custom_song_pak_template.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+struct RoundtripResult {
+	enum class Status {
+		Same,
+		Different,
+		Failed
+	};
+
+	std::string path;
+	Status status = Status::Failed;
+
+	//Only set when status is Failed
+	std::string error;
+	size_t errorOffset = 0;
+
+	//Only set when status is Different. The property is empty if the saved file diffs clean structurally.
+	size_t firstDifference = 0;
+	std::string firstDifferentProperty;
+
+	size_t inputSize = 0;
+	size_t outputSize = 0;
+	double parseMs = 0;
+	double writeMs = 0;
+
+	//Of the whole process when the file was done. Run with --threads 1 to pin a jump in it on one file.
+	size_t peakMemory = 0;
+};
+
+static size_t peakMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+static double msSince(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static std::vector<AssetDifference> diff(PakFile &before, PakFile &after) {
+	return diffPaks(before, after);
+}
+
+static std::vector<AssetDifference> diff(Asset &before, Asset &after) {
+	return diffAssets(before, after);
+}
+
+//setup points a buffer at the file, original is what it has to save back out as
+template<typename T, typename Setup>
+static void roundtrip(Setup &&setup, const u8 *original, size_t originalSize, RoundtripResult &result) {
+	T data;
+	if constexpr (std::is_same_v<T, PakFile>) {
+		//Decode every property, anything left raw would be saved back as it was and prove nothing
+		data.deferProperties = false;
+	}
+
+	auto parseStart = std::chrono::high_resolution_clock::now();
+	DataBuffer inBuf;
+	setup(inBuf);
+	inBuf.throwOnError = true;
+	inBuf.serialize(data);
+	result.parseMs = msSince(parseStart);
+
+	auto writeStart = std::chrono::high_resolution_clock::now();
+	std::vector<u8> outData;
+	DataBuffer outBuf;
+	outBuf.throwOnError = true;
+	outBuf.setupVectorFor(outData, data);
+	outBuf.serialize(data);
+	outBuf.finalize();
+	result.writeMs = msSince(writeStart);
+
+	result.outputSize = outData.size();
+
+	size_t common = std::min(originalSize, outData.size());
+	size_t firstDifference = std::mismatch(original, original + common, outData.data()).first - original;
+	if (firstDifference == common && originalSize == outData.size()) {
+		result.status = RoundtripResult::Status::Same;
+		return;
+	}
+
+	result.status = RoundtripResult::Status::Different;
+	result.firstDifference = firstDifference;
+
+	//Load what was written back in, so the difference can be put down to a property
+	try {
+		T resaved;
+		DataBuffer resavedBuf;
+		resavedBuf.setupVector(outData);
+		resavedBuf.throwOnError = true;
+		resavedBuf.serialize(resaved);
+
+		auto differences = diff(data, resaved);
+		if (!differences.empty()) {
+			result.firstDifferentProperty = differences[0].path;
+		}
+	}
+	catch (const std::exception &e) {
+		result.firstDifferentProperty = std::string("saved file doesn't load back: ") + e.what();
+	}
+}
+
+static RoundtripResult roundtripFile(const std::string &path) {
+	RoundtripResult result;
+	result.path = path;
+
+	try {
+		if (fs::path(path).extension() == ".pak") {
+			auto file = MappedFile::open(path);
+			if (!file) {
+				throw ParseError("Couldn't open file", 0);
+			}
+
+			result.inputSize = file->size();
+			roundtrip<PakFile>([&](DataBuffer &b) { b.setupSource(file); }, (const u8*)file->data(), file->size(), result);
+		}
+		else {
+			auto assetFile = fs::path(path);
+			auto uexpFile = assetFile.parent_path() / (assetFile.stem().string() + ".uexp");
+
+			std::ifstream infile(assetFile, std::ios_base::binary);
+			std::ifstream uexpfile(uexpFile, std::ios_base::binary);
+			if (!infile || !uexpfile) {
+				throw ParseError("Couldn't open the .uasset or its .uexp", 0);
+			}
+
+			std::vector<u8> fileData = std::vector<u8>(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+			fileData.insert(fileData.end(), std::istreambuf_iterator<char>(uexpfile), std::istreambuf_iterator<char>());
+
+			//Loading from a vector copies blobs out of it, so the original is kept intact for comparing against
+			std::vector<u8> loadData = fileData;
+
+			result.inputSize = fileData.size();
+			roundtrip<Asset>([&](DataBuffer &b) { b.setupVector(loadData); }, fileData.data(), fileData.size(), result);
+		}
+	}
+	catch (const ParseError &e) {
+		result.status = RoundtripResult::Status::Failed;
+		result.error = e.what();
+		result.errorOffset = e.offset;
+	}
+	catch (const std::exception &e) {
+		result.status = RoundtripResult::Status::Failed;
+		result.error = e.what();
+	}
+
+	result.peakMemory = peakMemory();
+	return result;
+}
+
+static void writeCsv(const std::string &path, const std::vector<RoundtripResult> &results) {
+	std::ofstream out(path);
+	out << "path,status,input_bytes,output_bytes,parse_ms,write_ms,peak_memory_bytes,first_difference,property,error\n";
+
+	for (auto &&r : results) {
+		const char *status = r.status == RoundtripResult::Status::Same ? "same" : r.status == RoundtripResult::Status::Different ? "different" : "failed";
+		out << "\"" << r.path << "\"," << status << "," << r.inputSize << "," << r.outputSize << "," << r.parseMs << "," << r.writeMs << "," << r.peakMemory << ",";
+		if (r.status == RoundtripResult::Status::Different) {
+			out << r.firstDifference;
+		}
+		out << ",\"" << r.firstDifferentProperty << "\",\"" << r.error << "\"\n";
+	}
+}
+
+//Loads, measures and writes the template every song is built from, runs times over, and reports the best time of each step.
+//Every property is decoded so all of them go through the serializers being timed.
+static int benchTemplate(size_t runs) {
+	auto file = MappedFile::fromMemory(custom_song_pak_template, sizeof(custom_song_pak_template));
+
+	double loadMs = 0;
+	double measureMs = 0;
+	double writeMs = 0;
+	std::vector<u8> outData;
+
+	for (size_t i = 0; i < runs; ++i) {
+		PakFile pak;
+		pak.deferProperties = false;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		DataBuffer inBuf;
+		inBuf.setupSource(file);
+		inBuf.throwOnError = true;
+		inBuf.serialize(pak);
+		double load = msSince(start);
+
+		DataBuffer outBuf;
+		outBuf.throwOnError = true;
+
+		start = std::chrono::high_resolution_clock::now();
+		size_t size = outBuf.measure(pak);
+		double measure = msSince(start);
+
+		outData.assign(size, 0);
+		start = std::chrono::high_resolution_clock::now();
+		outBuf.setupVector(outData);
+		outBuf.loading = false;
+		outBuf.measuredSize = size;
+		outBuf.serialize(pak);
+		outBuf.finalize();
+		double write = msSince(start);
+
+		if (i == 0 || load < loadMs) loadMs = load;
+		if (i == 0 || measure < measureMs) measureMs = measure;
+		if (i == 0 || write < writeMs) writeMs = write;
+	}
+
+	bool same = outData.size() == sizeof(custom_song_pak_template) && memcmp(outData.data(), custom_song_pak_template, outData.size()) == 0;
+	printf("custom_song_pak_template %s, best of %zu: load %.3f ms, measure %.3f ms, write %.3f ms\n", same ? "SAME" : "DIFF", runs, loadMs, measureMs, writeMs);
+	return same ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		printf("Usage: %s <directory> [--threads N] [--csv results.csv] [--parallel-exports]\n", argv[0]);
+		printf("       %s --template [--runs N] [--parallel-exports]\n", argv[0]);
+		return 2;
+	}
+
+	bool templateBench = std::string(argv[1]) == "--template";
+	std::string directory = argv[1];
+	size_t threadCount = 0;
+	size_t runs = 20;
+	std::string csvPath;
+
+	for (int i = 2; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc && !templateBench) {
+			threadCount = std::stoul(argv[++i]);
+		}
+		else if (arg == "--csv" && i + 1 < argc && !templateBench) {
+			csvPath = argv[++i];
+		}
+		else if (arg == "--runs" && i + 1 < argc && templateBench) {
+			runs = std::stoul(argv[++i]);
+		}
+		else if (arg == "--parallel-exports") {
+			//Puts every asset through the parallel load and save, however small
+			AssetData::parallelExportCount = 1;
+			AssetData::parallelExportBytes = 0;
+		}
+		else {
+			printf("Unknown argument %s\n", arg.c_str());
+			return 2;
+		}
+	}
+
+	if (templateBench) {
+		return benchTemplate(runs > 0 ? runs : 1);
+	}
+
+	auto files = findAssetFiles(directory);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<RoundtripResult> results(files.size());
+	parallel_for(files.size(), [&](size_t i) {
+		results[i] = roundtripFile(files[i]);
+	}, threadCount);
+	double totalMs = msSince(start);
+
+	size_t same = 0;
+	size_t different = 0;
+	size_t failed = 0;
+	size_t totalBytes = 0;
+	double parseMs = 0;
+	double writeMs = 0;
+
+	for (auto &&r : results) {
+		totalBytes += r.inputSize;
+		parseMs += r.parseMs;
+		writeMs += r.writeMs;
+
+		switch (r.status) {
+		case RoundtripResult::Status::Same:
+			++same;
+			printf("SAME %8.2f ms parse %8.2f ms write %7.1f MB peak  %s\n", r.parseMs, r.writeMs, r.peakMemory / (1024.0 * 1024.0), r.path.c_str());
+			break;
+		case RoundtripResult::Status::Different:
+			++different;
+			printf("DIFF %8.2f ms parse %8.2f ms write %7.1f MB peak  %s\n", r.parseMs, r.writeMs, r.peakMemory / (1024.0 * 1024.0), r.path.c_str());
+			printf("     first difference at 0x%zx (%zu bytes in, %zu out)%s%s\n", r.firstDifference, r.inputSize, r.outputSize,
+				r.firstDifferentProperty.empty() ? "" : ", ", r.firstDifferentProperty.c_str());
+			break;
+		case RoundtripResult::Status::Failed:
+			++failed;
+			printf("FAIL %s: %s (at 0x%zx)\n", r.path.c_str(), r.error.c_str(), r.errorOffset);
+			break;
+		}
+	}
+
+	double totalMB = totalBytes / (1024.0 * 1024.0);
+	printf("\n%zu files: %zu same, %zu different, %zu failed\n", results.size(), same, different, failed);
+	printf("%.1f MB in %.1f ms (%.1f MB/s), %.1f ms parsing and %.1f ms writing across all workers, peak memory %.1f MB\n",
+		totalMB, totalMs, totalMs > 0 ? totalMB / (totalMs / 1000.0) : 0.0, parseMs, writeMs, peakMemory() / (1024.0 * 1024.0));
+
+	if (!csvPath.empty()) {
+		writeCsv(csvPath, results);
+	}
+
+	return different + failed == 0 ? 0 : 1;
+}
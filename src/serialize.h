@@ -1,22 +1,78 @@
 #pragma once
 #include "core_types.h"
+#include "mapped_file.h"
 
 #include <type_traits>
 #include <functional>
 #include <optional>
+#include <stdexcept>
 
 template<class ...Ts>
 struct voider {
 	using type = void;
 };
 
+//Somewhere other than a block of memory for a root buffer to save into, see FileSink
+struct DataSink {
+	virtual ~DataSink() {}
+
+	virtual void write(size_t at, const u8 *data, size_t size) = 0;
+
+	//Rewrites bytes that may already be final, used for values patched through a FixupSlot
+	virtual void patch(size_t at, const u8 *data, size_t size) = 0;
+
+	//SHA1 of the bytes from at up to end, computed as they go out
+	virtual void beginHash(size_t at) = 0;
+	virtual void endHash(size_t end, u8 *digest) = 0;
+
+	virtual void finish() = 0;
+};
+
+//Thrown by a sink that can't write what it was given, or that was given something it can't write correctly
+//(like a change to bytes that have already been hashed). What's been written so far shouldn't be used.
+struct SinkError : std::runtime_error {
+	SinkError(const std::string &message) : std::runtime_error(message) {}
+};
+
+//Malformed input, thrown instead of breaking into the debugger when a buffer has throwOnError set.
+//offset is from the start of the file when loading from a MappedFile, otherwise from the start of the buffer.
+struct ParseError : std::runtime_error {
+	size_t offset;
+
+	ParseError(const std::string &message, size_t offset) : std::runtime_error(message), offset(offset) {}
+};
+
+template<typename P>
+struct PolicyBuffer;
+
+//Holds what a load or save works with, and picks how to serialize into it. Serializers are templated on the policy and
+//take a PolicyBuffer, see below, a DataBuffer hands them one for the mode it's set up for.
 struct DataBuffer {
 	bool loading = true;
+
+	//For scanning lots of files: bad input throws a ParseError so it can be skipped, instead of breaking into the debugger
+	bool throwOnError = false;
+
+	//Save mode that only tracks how far it would have written. Nothing is copied, resized or watched.
+	bool measuring = false;
 	size_t pos = 0;
 	size_t size = 0;
 	u8* buffer = nullptr;
-	void *ctx_;
-	std::function<void(size_t)> resize;
+	void *ctx_ = nullptr;
+
+	//Vector backing a save set up with setupVector, grown directly as writes go past the end
+	std::vector<u8> *target = nullptr;
+
+	//Set by setupVectorFor. finalize checks that the write ended exactly where the measure said it would,
+	//using how far the Writer actually got.
+	std::optional<size_t> measuredSize;
+	size_t written = 0;
+
+	//When loading from a mapped file, blobs are kept as views into it instead of being copied out
+	std::shared_ptr<MappedFile> source;
+
+	//When saving through a sink, the root buffer has no memory of its own and everything goes to the sink
+	DataSink *sink = nullptr;
 
 	bool watch_ = false;
 	struct WatchedValue {
@@ -26,67 +82,168 @@ struct DataBuffer {
 	};
 	std::vector<WatchedValue> watchedValues;
 
+	//Values that are reserved on write and patched once later by whoever holds the slot, instead of being searched for or re-copied
+	struct Fixup {
+		size_t buffer_pos;
+		size_t size;
+	};
+	std::vector<Fixup> fixups;
+
+	template<typename T>
+	struct FixupSlot {
+		static constexpr size_t npos = (size_t)-1;
+		size_t index = npos;
+
+		bool valid() const {
+			return index != npos;
+		}
+	};
+
 	std::vector<std::function<void(DataBuffer &)>> finalizeFunctions;
 
 	struct DerivedBuffer {
 		DataBuffer *base = nullptr;
 		size_t offset = 0;
+
+		//The buffer that actually owns the storage, and where this buffer starts in it
+		DataBuffer *root = nullptr;
+		size_t rootOffset = 0;
 	};
 	std::optional<DerivedBuffer> derivedBuffer;
 	
 
-	DataBuffer() {
-		resize = [](size_t) {
-			throw std::out_of_range("Cannot resize the buffer!");
-		};
-	}
+	DataBuffer() {}
 
-	void watch(std::function<void()> fn) {
+	//Serializes data with the policy for how this buffer is set up. The mode is looked at once here, everything
+	//below runs in a PolicyBuffer for it.
+	template<typename T>
+	void serialize(T &data);
+
+	template<typename Fn>
+	void watch(Fn &&fn) {
 		watch_ = true;
 		fn();
 		watch_ = false;
 	}
 
 	void finalize() {
+		if (measuredSize.has_value() && written != *measuredSize) {
+			error("Save wrote " + std::to_string(written) + " bytes, but was measured at " + std::to_string(*measuredSize), written);
+		}
+
 		for (auto &&w : watchedValues) {
-			memcpy(buffer + w.buffer_pos, w.data, w.size);
+			if (sink) {
+				sink->write(w.buffer_pos, w.data, w.size);
+			}
+			else {
+				memcpy(buffer + w.buffer_pos, w.data, w.size);
+			}
 		}
 
 		for (auto &&f : finalizeFunctions) {
 			f(*this);
 		}
 		watchedValues.clear();
+		fixups.clear();
+
+		if (sink) {
+			sink->finish();
+		}
 	}
 
-	DataBuffer setupFromHere() {
-		DerivedBuffer dB;
-		dB.base = this;
-		dB.offset = pos;
+	DataBuffer& rootBuffer() {
+		return derivedBuffer.has_value() ? *derivedBuffer->root : *this;
+	}
 
-		DataBuffer newBuffer;
-		newBuffer.buffer = nullptr;
-		newBuffer.pos = 0;
-		newBuffer.ctx_ = ctx_;
-		newBuffer.loading = loading;
-		if (loading) {
-			newBuffer.size = size - pos;
+	size_t rootPos() const {
+		return (derivedBuffer.has_value() ? derivedBuffer->rootOffset : 0) + pos;
+	}
+
+	template<typename T>
+	void patch(const FixupSlot<T> &slot, const T &value) {
+		auto &f = fixups[slot.index];
+		if (sink) {
+			sink->patch(f.buffer_pos, (const u8*)&value, f.size);
 		}
 		else {
-			newBuffer.size = 0;
+			memcpy(buffer + f.buffer_pos, &value, f.size);
 		}
-		newBuffer.derivedBuffer = dB;
+	}
 
-		return newBuffer;
+	void setupSource(std::shared_ptr<MappedFile> file) {
+		source = std::move(file);
+		buffer = (u8*)source->data();
+		size = source->size();
+		loading = true;
 	}
 
 	void setupVector(std::vector<u8> &v) {
 		buffer = v.data();
 		size = v.size();
-		resize = [&](size_t sz) {
-			v.resize(sz);
-			buffer = v.data();
-			size = sz;
-		};
+		target = &v;
+	}
+
+	void grow(size_t sz) {
+		if (target == nullptr) {
+			error("Write up to " + std::to_string(sz) + " goes past the end of a " + std::to_string(size) + " byte buffer that can't grow", size);
+			throw std::out_of_range("Cannot resize the buffer!");
+		}
+
+		target->resize(sz);
+		buffer = target->data();
+		size = sz;
+	}
+
+	void setupSink(DataSink &s) {
+		sink = &s;
+		buffer = nullptr;
+		pos = 0;
+		size = 0;
+		loading = false;
+	}
+
+	//Walks data in save mode without writing anything, and returns the size the real write will have.
+	//Errors and ctx are the same as this buffer's, so the measure fails the same way the write would.
+	template<typename T>
+	size_t measure(T &data) {
+		DataBuffer b;
+		b.loading = false;
+		b.measuring = true;
+		b.throwOnError = throwOnError;
+		b.ctx_ = ctx_;
+		b.serialize(data);
+		return b.size;
+	}
+
+	//Sets up a save into v, allocated once at the exact size of data, so the write never has to grow it
+	template<typename T>
+	void setupVectorFor(std::vector<u8> &v, T &data) {
+		size_t sz = measure(data);
+		v.assign(sz, 0);
+		setupVector(v);
+		loading = false;
+		measuredSize = sz;
+		written = 0;
+	}
+
+	//at is a position in the root buffer
+	void error(const std::string &message, size_t at) {
+		if (!throwOnError) {
+			printf("%s\n", message.c_str());
+			__debugbreak();
+			return;
+		}
+
+		auto &root = rootBuffer();
+		if (source && root.buffer) {
+			at += (root.buffer - source->data());
+		}
+
+		throw ParseError(message, at);
+	}
+
+	void error(const std::string &message) {
+		error(message, rootPos());
 	}
 
 	template<typename T>
@@ -94,19 +251,135 @@ struct DataBuffer {
 		return *reinterpret_cast<T*>(ctx_);
 	}
 
+	//A count read from the file can't need more bytes than are left, catches garbage before it turns into a huge allocation.
+	//Elements that aren't stored as a block are assumed to take at least minElementSize.
+	void checkCount(size_t count, size_t minElementSize) {
+		if (pos > size || count > (size - pos) / minElementSize) {
+			error("Count of " + std::to_string(count) + " is larger than the rest of the buffer");
+		}
+	}
+
+	//Access policies for the root buffer, one per mode. A PolicyBuffer is built on one of them, which makes loading and
+	//measuring constants in every serializer instantiated for it. Size is size_t, or std::integral_constant when
+	//serializeFixed knows it at compile time.
+	struct Reader {
+		static constexpr bool loading = true;
+		static constexpr bool measuring = false;
+
+		template<typename Size>
+		static void access(DataBuffer &root, size_t at, u8 *data, Size data_size, bool) {
+			if (at + data_size > root.size) {
+				root.error("Read past the end of the buffer", at);
+				return;
+			}
+
+			memcpy(data, root.buffer + at, data_size);
+		}
+	};
+
+	struct Sizer {
+		static constexpr bool loading = false;
+		static constexpr bool measuring = true;
+
+		template<typename Size>
+		static void access(DataBuffer &root, size_t at, u8 *, Size data_size, bool) {
+			if (at + data_size > root.size) {
+				root.size = at + data_size;
+			}
+		}
+	};
+
+	struct Writer {
+		static constexpr bool loading = false;
+		static constexpr bool measuring = false;
+
+		template<typename Size>
+		static void access(DataBuffer &root, size_t at, u8 *data, Size data_size, bool watched) {
+			//Growing the vector also 0's anything we've seeked over
+			if (at + data_size > root.size) {
+				root.grow(at + data_size);
+			}
+
+			memcpy(root.buffer + at, data, data_size);
+			if (at + data_size > root.written) {
+				root.written = at + data_size;
+			}
+
+			record(root, at, data, data_size, watched);
+		}
+	};
+
+	struct SinkWriter {
+		static constexpr bool loading = false;
+		static constexpr bool measuring = false;
+
+		template<typename Size>
+		static void access(DataBuffer &root, size_t at, u8 *data, Size data_size, bool watched) {
+			root.sink->write(at, data, data_size);
+			if (at + data_size > root.size) {
+				root.size = at + data_size;
+			}
+
+			record(root, at, data, data_size, watched);
+		}
+	};
+
+	static void record(DataBuffer &root, size_t at, u8 *data, size_t data_size, bool watched) {
+		if (watched) {
+			WatchedValue v;
+			v.buffer_pos = at;
+			v.data = data;
+			v.size = data_size;
+			root.watchedValues.emplace_back(v);
+		}
+	}
+
+	template<class T, class = void>
+	struct has_serialize : std::false_type {};
+
+	template<class T>
+	struct has_serialize<T, typename voider<decltype(std::declval<T>().serialize(std::declval<PolicyBuffer<Reader>&>()))>::type> : std::true_type {};
+
+	//Records opt in with `static constexpr size_t fixed_layout_size = N;` when their members are laid out exactly like the file
+	//(little endian, no padding, nothing that owns memory). They're read and written as one block instead of field by field.
+	template<class T, class = void>
+	struct is_fixed_layout : std::false_type {};
+
+	template<class T>
+	struct is_fixed_layout<T, typename voider<decltype(T::fixed_layout_size)>::type> : std::true_type {
+		static_assert(sizeof(T) == T::fixed_layout_size, "Record no longer matches its file layout!");
+		static_assert(std::is_trivially_copyable_v<T>, "Fixed layout records have to be trivially copyable!");
+	};
+
+	//Plain numbers, enums and fixed layout records are stored exactly as they are laid out in memory, so a run of them can be moved as one block.
+	//bool is excluded because std::vector<bool> has no contiguous storage.
+	template<class T>
+	struct is_bulk_serializable : std::bool_constant<((std::is_arithmetic_v<T> || std::is_enum_v<T>) && !std::is_same_v<T, bool> && !has_serialize<T>::value) || is_fixed_layout<T>::value> {};
+
+private:
+	template<typename P, typename T>
+	void serializeWith(T &data);
+};
+
+//A DataBuffer fixed to one policy. Every serialize is a template on the policy, so within one instantiation buffer.loading
+//and buffer.measuring are compile time constants: the load/save branches fold away and primitives go straight to the
+//policy's copy. Derived buffers made with setupFromHere keep the policy.
+template<typename P>
+struct PolicyBuffer : DataBuffer {
+	static constexpr bool loading = P::loading;
+	static constexpr bool measuring = P::measuring;
+
+	PolicyBuffer() {
+		DataBuffer::loading = loading;
+		DataBuffer::measuring = measuring;
+	}
+
+	//Takes over a buffer set up for P, DataBuffer::serialize hands it back after
+	explicit PolicyBuffer(DataBuffer &&b) : DataBuffer(std::move(b)) {}
 
 	void serialize(u8 *data, size_t data_size) {
 		if (derivedBuffer.has_value()) {
-			size_t prevPos = derivedBuffer->base->pos;
-			bool prevWatch = derivedBuffer->base->watch_;
-			
-			derivedBuffer->base->pos = pos + derivedBuffer->offset;
-			derivedBuffer->base->watch_ = watch_;
-			
-			derivedBuffer->base->serialize(data, data_size);
-
-			derivedBuffer->base->watch_ = prevWatch;
-			derivedBuffer->base->pos = prevPos;
+			serializeAt(*derivedBuffer->root, derivedBuffer->rootOffset + pos, data, data_size, watch_);
 
 			pos += data_size;
 			if (!loading && pos > size) {
@@ -116,70 +389,110 @@ struct DataBuffer {
 			return;
 		}
 
-		if (data_size > 1024) {
-			__debugbreak();
-		}
+		serializeAt(*this, pos, data, data_size, watch_);
+		pos += data_size;
+	}
+
+	//Same as above, but with the size carried as a type all the way into the policy, so its copy is of a constant size
+	template<size_t N>
+	void serializeFixed(u8 *data) {
+		using Size = std::integral_constant<size_t, N>;
+
+		if (derivedBuffer.has_value()) {
+			serializeAt(*derivedBuffer->root, derivedBuffer->rootOffset + pos, data, Size(), watch_);
+
+			pos += N;
+			if (!loading && pos > size) {
+				size = pos;
+			}
 
-		if (loading && pos + data_size > size) {
-			__debugbreak();
 			return;
 		}
 
-#ifdef _DEBUG
-		//constexpr u32 dbgpos = 78;
-		//if (!loading) {
-		//	if (pos <= dbgpos && pos + data_size > dbgpos) {
-		//		__debugbreak();
-		//	}
-		//}
-#endif
+		serializeAt(*this, pos, data, Size(), watch_);
+		pos += N;
+	}
 
-		if (loading) {
-			memcpy(data, buffer + pos, data_size);
+	//Writes value now and hands back a slot for patching it later. Slots always refer to the root buffer.
+	template<typename T>
+	FixupSlot<T> reserve(T &value) {
+		FixupSlot<T> slot;
+		if (loading || measuring) {
+			serialize(value);
+			return slot;
 		}
-		else {
-			//If we've seeked ahead, then write 0's until the new position
-			if (pos > size) {
-				u32 diff = (pos - size);
-				resize(size + diff);
-				memset(buffer + pos - diff, 0, diff);
-			}
 
-			//Ensure size
-			if (pos + data_size > size) {
-				resize(pos + data_size);
-			}
+		size_t at = rootPos();
+		serialize(value);
 
-			memcpy(buffer + pos, data, data_size);
+		auto &root = rootBuffer();
+		slot.index = root.fixups.size();
+		root.fixups.push_back({ at, sizeof(T) });
+		return slot;
+	}
 
-			if (watch_) {
-				WatchedValue v;
-				v.buffer_pos = pos;
-				v.data = data;
-				v.size = data_size;
-				watchedValues.emplace_back(v);
-			}
+	PolicyBuffer setupFromHere() {
+		DerivedBuffer dB;
+		dB.base = this;
+		dB.offset = pos;
+		dB.root = derivedBuffer.has_value() ? derivedBuffer->root : this;
+		dB.rootOffset = (derivedBuffer.has_value() ? derivedBuffer->rootOffset : 0) + pos;
+
+		PolicyBuffer newBuffer;
+		newBuffer.buffer = nullptr;
+		newBuffer.pos = 0;
+		newBuffer.ctx_ = ctx_;
+		newBuffer.throwOnError = throwOnError;
+		newBuffer.source = source;
+		if (loading) {
+			newBuffer.size = size - pos;
 		}
+		else {
+			newBuffer.size = 0;
+		}
+		newBuffer.derivedBuffer = dB;
 
-		pos += data_size;
+		return newBuffer;
 	}
 
-	template<class T, class = void>
-	struct has_serialize : std::false_type {};
+	//Picks up after the data written into a buffer made with setupFromHere()
+	void endDerived(const PolicyBuffer &derived) {
+		pos = derived.derivedBuffer->offset + derived.pos;
+		if (!loading && derived.derivedBuffer->offset + derived.size > size) {
+			size = derived.derivedBuffer->offset + derived.size;
+		}
+	}
 
-	template<class T>
-	struct has_serialize<T, typename voider<decltype(std::declval<T>().serialize(std::declval<DataBuffer&>()))>::type> : std::true_type {};
+	template<typename T>
+	void serializeSpan(T *data, size_t count) {
+		if constexpr (is_bulk_serializable<T>::value) {
+			if (count == 1) {
+				serializeFixed<sizeof(T)>((u8*)data);
+			}
+			else if (count != 0) {
+				serialize((u8*)data, count * sizeof(T));
+			}
+		}
+		else {
+			for (size_t i = 0; i < count; ++i) {
+				serialize(data[i]);
+			}
+		}
+	}
 
 	template<typename T>
 	void serialize(T& data) {
-		if constexpr (has_serialize<T>::value) {
+		if constexpr (is_fixed_layout<T>::value) {
+			serializeFixed<sizeof(T)>((u8*)&data);
+		}
+		else if constexpr (has_serialize<T>::value) {
 			data.serialize(*this);
 		}
 		else if constexpr (std::is_fundamental_v<T>) {
-			serialize((u8*)&data, sizeof(T));
+			serializeFixed<sizeof(T)>((u8*)&data);
 		}
 		else if constexpr (std::is_enum_v<T>) {
-			serialize((u8*)&data, sizeof(std::underlying_type_t<T>));
+			serializeFixed<sizeof(std::underlying_type_t<T>)>((u8*)&data);
 		}
 		else {
 			static_assert(false, "Unsupported type to serialize!");
@@ -188,9 +501,7 @@ struct DataBuffer {
 
 	template<typename T, size_t N>
 	void serialize(T (&data)[N]) {
-		for (size_t i = 0; i < N; ++i) {
-			serialize(data[i]);
-		}
+		serializeSpan(data, N);
 	}
 
 	template<typename T>
@@ -199,23 +510,48 @@ struct DataBuffer {
 		serialize(size);
 
 		if (loading) {
+			checkCount(size, is_bulk_serializable<T>::value ? sizeof(T) : 1);
 			data.resize(size);
 		}
 
-		for (u32 i = 0; i < size; ++i) {
-			serialize(data[i]);
-		}
+		serializeSpan(data.data(), size);
 	}
 
 	template<typename T>
 	void serializeWithSize(std::vector<T>& data, size_t size) {
 		if (loading) {
+			checkCount(size, is_bulk_serializable<T>::value ? sizeof(T) : 1);
 			data.resize(size);
 		}
 
-		for (u32 i = 0; i < size; ++i) {
-			serialize(data[i]);
+		serializeSpan(data.data(), size);
+	}
+
+	void serializeWithSize(DataBlob& data, size_t size) {
+		if (!loading) {
+			if (size != 0) {
+				serialize((u8*)data.data(), size);
+			}
+			return;
 		}
+
+		if (source) {
+			size_t absolutePos = rootPos();
+			auto &root = rootBuffer();
+
+			if (absolutePos + size > root.size) {
+				error("Blob runs past the end of the buffer");
+				return;
+			}
+
+			data.setView(source, (root.buffer + absolutePos) - source->data(), size);
+			pos += size;
+			return;
+		}
+
+		std::vector<u8> bytes;
+		serializeWithSize(bytes, size);
+		data = std::move(bytes);
 	}
 
 	void serialize(std::string& data) {
@@ -226,6 +562,7 @@ struct DataBuffer {
 			serialize(size);
 
 			if (size != 0) {
+				checkCount(size, 1);
 				data.resize(size - 1);
 				serialize((u8*)data.data(), size - 1);
 				pos += 1;
@@ -243,4 +580,55 @@ struct DataBuffer {
 			}
 		}
 	}
-};
\ No newline at end of file
+
+private:
+	//Reads or writes at an absolute position in root. Derived buffers go straight here instead of through each parent.
+	template<typename Size>
+	static void serializeAt(DataBuffer &root, size_t at, u8 *data, Size data_size, bool watched) {
+#ifdef _DEBUG
+		//constexpr u32 dbgpos = 78;
+		//if (!loading) {
+		//	if (at <= dbgpos && at + data_size > dbgpos) {
+		//		__debugbreak();
+		//	}
+		//}
+#endif
+
+		P::access(root, at, data, data_size, watched);
+	}
+};
+
+using ReadBuffer = PolicyBuffer<DataBuffer::Reader>;
+using SizeBuffer = PolicyBuffer<DataBuffer::Sizer>;
+using WriteBuffer = PolicyBuffer<DataBuffer::Writer>;
+using SinkBuffer = PolicyBuffer<DataBuffer::SinkWriter>;
+
+template<typename T>
+void DataBuffer::serialize(T &data) {
+	if (loading) {
+		serializeWith<Reader>(data);
+	}
+	else if (measuring) {
+		serializeWith<Sizer>(data);
+	}
+	else if (sink) {
+		serializeWith<SinkWriter>(data);
+	}
+	else {
+		serializeWith<Writer>(data);
+	}
+}
+
+//The state moves into a PolicyBuffer for the call and back out after, so the serializers see this buffer as it was set up
+template<typename P, typename T>
+void DataBuffer::serializeWith(T &data) {
+	PolicyBuffer<P> b(std::move(*this));
+	try {
+		b.serialize(data);
+	}
+	catch (...) {
+		*this = std::move(b);
+		throw;
+	}
+	*this = std::move(b);
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include "core_types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//One set of worker threads shared by every parallel_for. A parallel_for inside another (the exports of an asset
+//inside a scan over files) hands its work to the same threads instead of starting more of its own.
+class ThreadPool {
+public:
+	struct Job {
+		std::function<void(size_t)> fn;
+		size_t count = 0;
+		size_t maxThreads = 1;
+
+		std::atomic<size_t> next = 0;
+		std::atomic<bool> failed = false;
+		std::exception_ptr error;
+
+		//Threads in the work loop, guarded by the pool mutex
+		size_t threads = 0;
+	};
+
+	static ThreadPool& get() {
+		static ThreadPool pool;
+		return pool;
+	}
+
+	//Works on job from the calling thread along with any free workers, and returns once every item is done
+	void run(Job &job) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job.threads = 1;
+			jobs.push_back(&job);
+		}
+		workAvailable.notify_all();
+
+		work(job);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		jobs.erase(std::find(jobs.begin(), jobs.end(), &job));
+		--job.threads;
+		jobDone.wait(lock, [&]() { return job.threads == 0; });
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		workAvailable.notify_all();
+
+		for (auto &&t : workers) {
+			t.join();
+		}
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::vector<Job*> jobs;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable jobDone;
+	bool stopping = false;
+
+	//The thread calling parallel_for works too, so one fewer than there are cores
+	ThreadPool() {
+		size_t threadCount = std::thread::hardware_concurrency();
+		for (size_t t = 1; t < threadCount; ++t) {
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	static void work(Job &job) {
+		for (size_t i = job.next++; i < job.count; i = job.next++) {
+			if (job.failed) {
+				continue;
+			}
+
+			try {
+				job.fn(i);
+			}
+			catch (...) {
+				if (!job.failed.exchange(true)) {
+					job.error = std::current_exception();
+				}
+			}
+		}
+	}
+
+	//A job with items left to hand out and room for another thread. Called with the mutex held.
+	Job* findJob() {
+		for (auto &&job : jobs) {
+			if (job->next < job->count && job->threads < job->maxThreads) {
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	void workerLoop() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			Job *job = nullptr;
+			workAvailable.wait(lock, [&]() { return stopping || (job = findJob()) != nullptr; });
+			if (stopping) {
+				return;
+			}
+
+			++job->threads;
+			lock.unlock();
+			work(*job);
+			lock.lock();
+
+			--job->threads;
+			jobDone.notify_all();
+		}
+	}
+};
+
+//Runs fn(i) for every i in [0, count) on the shared pool, using at most threadCount threads including the caller's.
+//Work is handed out one index at a time, so uneven items (a huge pak next to a tiny uasset) still balance.
+//The first exception thrown by fn is rethrown here after every item has stopped.
+template<typename Fn>
+void parallel_for(size_t count, Fn &&fn, size_t threadCount = 0) {
+	if (threadCount == 0) {
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if (threadCount > count) {
+		threadCount = count;
+	}
+
+	if (threadCount <= 1) {
+		for (size_t i = 0; i < count; ++i) {
+			fn(i);
+		}
+		return;
+	}
+
+	ThreadPool::Job job;
+	job.fn = [&](size_t i) { fn(i); };
+	job.count = count;
+	job.maxThreads = threadCount;
+	ThreadPool::get().run(job);
+
+	if (job.error) {
+		std::rethrow_exception(job.error);
+	}
+}
@@ -1,146 +1,175 @@
 #include "uasset.h"
 
+#include <array>
+#include <string_view>
+#include <unordered_map>
+
 namespace asset_helper {
-	PropertyValue createPropertyValue(const std::string &type, const bool useUnknown) {
-		if (type == "BoolProperty") {
-			return BoolProperty{};
-		}
-		else if (type == "Int8Property") {
-			return PrimitiveProperty<i8>{};
-		}
-		else if (type == "Int16Property") {
-			return PrimitiveProperty<i16>{};
-		}
-		else if (type == "IntProperty") {
-			return PrimitiveProperty<i32>{};
-		}
-		else if (type == "Int64Property") {
-			return PrimitiveProperty<i64>{};
-		}
-		else if (type == "UInt16Property") {
-			return PrimitiveProperty<u16>{};
-		}
-		else if (type == "UInt32Property") {
-			return PrimitiveProperty<u32>{};
-		}
-		else if (type == "UInt64Property") {
-			return PrimitiveProperty<u64>{};
-		}
-		else if (type == "FloatProperty") {
-			return PrimitiveProperty<float>{};
-		}
-		else if (type == "TextProperty") {
-			return TextProperty{};
-		}
-		else if (type == "StrProperty") {
-			return StringProperty{};
-		}
-		else if (type == "ObjectProperty") {
-			return ObjectProperty{};
-		}
-		else if (type == "EnumProperty") {
-			return EnumProperty{};
-		}
-		else if (type == "ByteProperty") {
-			return ByteProperty{};
-		}
-		else if (type == "NameProperty") {
-			return NameProperty{};
-		}
-		else if (type == "ArrayProperty") {
-			return ArrayProperty{};
-		}
-		else if (type == "MapProperty") {
-			return MapProperty{};
-		}
-		else if (type == "StructProperty") {
-			return StructProperty{};
-		}
-		else if (type == "Guid") {
-			return PrimitiveProperty<Guid>{};
-		}
-		else if (type == "SoftObjectProperty") {
-			return SoftObjectProperty{};
-		}
-		else if (type == "DateTime") {
-			return DateTime{};
+	struct PropertyType {
+		std::string_view name;
+		size_t variantIndex;
+		size_t tagSize;
+		bool hasLength;
+		PropertyValue (*create)();
+		ArrayProperty::TypedValues (*createArray)();
+	};
+
+	template<class T, class = void>
+	struct has_length : std::false_type {};
+
+	template<class T>
+	struct has_length<T, typename voider<decltype(T::needs_length)>::type> : std::true_type {};
+
+	//Types with a custom header say how many bytes it is, everything else has the single byte serialize writes for them
+	template<class T, class = void>
+	struct property_tag_size : std::integral_constant<size_t, 1> {};
+
+	template<class T>
+	struct property_tag_size<T, typename voider<decltype(T::tag_size)>::type> : std::integral_constant<size_t, T::tag_size> {};
+
+	//Storage for an ArrayProperty of T, empty if T has no typed storage
+	template<typename T>
+	static ArrayProperty::TypedValues typedArray() {
+		if constexpr (std::is_constructible_v<ArrayProperty::TypedValues, std::vector<T>>) {
+			return std::vector<T>{};
 		}
 		else {
-			if (useUnknown) {
-				printf("Unknown type %s!\n", type.c_str());
-				return UnknownProperty{};
-			}
-			else {
-				return new IPropertyDataList();
-			}
+			return std::monostate{};
 		}
 	}
 
-	std::string getTypeForValue(const PropertyValue &v) {
-		if (std::holds_alternative<BoolProperty>(v)) {
-			return "BoolProperty";
-		}
-		else if (std::holds_alternative<PrimitiveProperty<i8>>(v)) {
-			return "Int8Property";
-		}
-		else if (std::holds_alternative<PrimitiveProperty<i16>>(v)) {
-			return "Int16Property";
-		}
-		else if (std::holds_alternative<PrimitiveProperty<i32>>(v)) {
-			return "IntProperty";
-		}
-		else if (std::holds_alternative<PrimitiveProperty<i64>>(v)) {
-			return "Int64Property";
-		}
-		else if (std::holds_alternative<PrimitiveProperty<u16>>(v)) {
-			return "UInt16Property";
-		}
-		else if (std::holds_alternative<PrimitiveProperty<u32>>(v)) {
-			return "UInt32Property";
-		}
-		else if (std::holds_alternative<PrimitiveProperty<u64>>(v)) {
-			return "UInt64Property";
-		}
-		else if (std::holds_alternative<PrimitiveProperty<float>>(v)) {
-			return "FloatProperty";
-		}
-		else if (std::holds_alternative<TextProperty>(v)) {
-			return "TextProperty";
-		}
-		else if (std::holds_alternative<StringProperty>(v)) {
-			return "StrProperty";
-		}
-		else if (std::holds_alternative<ObjectProperty>(v)) {
-			return "ObjectProperty";
-		}
-		else if (std::holds_alternative<EnumProperty>(v)) {
-			return "EnumProperty";
+	template<typename T>
+	static PropertyType propertyType(std::string_view name) {
+		return { name, PropertyValue(std::in_place_type<T>).index(), property_tag_size<T>::value, has_length<T>::value, []() -> PropertyValue { return T{}; }, typedArray<T> };
+	}
+
+	//A PropertyTypeId is a position in this table
+	static const std::vector<PropertyType>& propertyTypes() {
+		static const std::vector<PropertyType> types = {
+			propertyType<BoolProperty>("BoolProperty"),
+			propertyType<PrimitiveProperty<i8>>("Int8Property"),
+			propertyType<PrimitiveProperty<i16>>("Int16Property"),
+			propertyType<PrimitiveProperty<i32>>("IntProperty"),
+			propertyType<PrimitiveProperty<i64>>("Int64Property"),
+			propertyType<PrimitiveProperty<u16>>("UInt16Property"),
+			propertyType<PrimitiveProperty<u32>>("UInt32Property"),
+			propertyType<PrimitiveProperty<u64>>("UInt64Property"),
+			propertyType<PrimitiveProperty<float>>("FloatProperty"),
+			propertyType<TextProperty>("TextProperty"),
+			propertyType<StringProperty>("StrProperty"),
+			propertyType<ObjectProperty>("ObjectProperty"),
+			propertyType<EnumProperty>("EnumProperty"),
+			propertyType<ByteProperty>("ByteProperty"),
+			propertyType<NameProperty>("NameProperty"),
+			propertyType<ArrayProperty>("ArrayProperty"),
+			propertyType<MapProperty>("MapProperty"),
+			propertyType<StructProperty>("StructProperty"),
+			propertyType<PrimitiveProperty<Guid>>("Guid"),
+			propertyType<SoftObjectProperty>("SoftObjectProperty"),
+			propertyType<DateTime>("DateTime"),
+		};
+		return types;
+	}
+
+	PropertyTypeId getTypeId(std::string_view type) {
+		static const auto ids = []() {
+			std::unordered_map<std::string_view, PropertyTypeId> ids;
+			auto &&types = propertyTypes();
+			for (size_t i = 0; i < types.size(); ++i) {
+				ids.emplace(types[i].name, (PropertyTypeId)i);
+			}
+			return ids;
+		}();
+
+		auto it = ids.find(type);
+		return it != ids.end() ? it->second : UNKNOWN_PROPERTY_TYPE;
+	}
+
+	PropertyValue createPropertyValue(PropertyTypeId type, PropertyArena &arena, const bool useUnknown) {
+		if (type != UNKNOWN_PROPERTY_TYPE) {
+			return propertyTypes()[type].create();
 		}
-		else if (std::holds_alternative<ByteProperty>(v)) {
-			return "ByteProperty";
+		else if (useUnknown) {
+			return UnknownProperty{};
 		}
-		else if (std::holds_alternative<ArrayProperty>(v)) {
-			return "ArrayProperty";
+		else {
+			return arena.create<IPropertyDataList>();
 		}
-		else if (std::holds_alternative<MapProperty>(v)) {
-			return "MapProperty";
+	}
+
+	static PropertyTypeId getTypeId(AssetCtx &ctx, i64 ref, const std::string &str) {
+		if (ctx.parsingSaveFormat) {
+			return getTypeId(str);
 		}
-		else if (std::holds_alternative<StructProperty>(v)) {
-			return "StructProperty";
+
+		//Look each name up the first time it's used as a type, after that it's just an index
+		if (ref < 0 || ref >= (i64)ctx.header->names.size()) {
+			return UNKNOWN_PROPERTY_TYPE;
 		}
-		else if (std::holds_alternative<PrimitiveProperty<Guid>>(v)) {
-			return "Guid";
+
+		if (ctx.nameTypeIds.size() != ctx.header->names.size()) {
+			ctx.nameTypeIds.assign(ctx.header->names.size(), AssetCtx::TYPE_NOT_LOOKED_UP);
 		}
-		else if (std::holds_alternative<SoftObjectProperty>(v)) {
-			return "SoftObjectProperty";
+
+		auto &&id = ctx.nameTypeIds[ref];
+		if (id == AssetCtx::TYPE_NOT_LOOKED_UP) {
+			id = getTypeId(ctx.header->getHeaderRef(ref));
 		}
-		else if (std::holds_alternative<DateTime>(v)) {
-			return "DateTime";
+		return id;
+	}
+
+	PropertyTypeId getTypeId(AssetCtx &ctx, const StringRef32 &type) {
+		return getTypeId(ctx, type.ref, type.str);
+	}
+
+	PropertyTypeId getTypeId(AssetCtx &ctx, const StringRef64 &type) {
+		return getTypeId(ctx, type.ref, type.str);
+	}
+
+	size_t getTagSize(PropertyTypeId type) {
+		return type != UNKNOWN_PROPERTY_TYPE ? propertyTypes()[type].tagSize : 1;
+	}
+
+	static ArrayProperty::TypedValues createTypedArray(PropertyTypeId type) {
+		return type != UNKNOWN_PROPERTY_TYPE ? propertyTypes()[type].createArray() : std::monostate{};
+	}
+
+	bool canDefer(PropertyTypeId type) {
+		return type != UNKNOWN_PROPERTY_TYPE && propertyTypes()[type].hasLength;
+	}
+
+	static PropertyValue createPropertyValue(AssetCtx &ctx, i64 ref, const std::string &str, const bool useUnknown) {
+		PropertyTypeId type = getTypeId(ctx, ref, str);
+		if (type == UNKNOWN_PROPERTY_TYPE && useUnknown) {
+			printf("Unknown type %s!\n", ctx.parsingSaveFormat ? str.c_str() : ctx.header->getHeaderRef(ref).c_str());
 		}
-		else if (std::holds_alternative<IPropertyDataList*>(v)) {
+		return createPropertyValue(type, *ctx.arena, useUnknown);
+	}
+
+	PropertyValue createPropertyValue(AssetCtx &ctx, const StringRef32 &type, const bool useUnknown) {
+		return createPropertyValue(ctx, type.ref, type.str, useUnknown);
+	}
+
+	PropertyValue createPropertyValue(AssetCtx &ctx, const StringRef64 &type, const bool useUnknown) {
+		return createPropertyValue(ctx, type.ref, type.str, useUnknown);
+	}
+
+	std::string getTypeForValue(const PropertyValue &v) {
+		static const auto names = []() {
+			std::array<std::string_view, std::variant_size_v<PropertyValue>> names;
+			for (auto &&t : propertyTypes()) {
+				names[t.variantIndex] = t.name;
+			}
+			return names;
+		}();
+
+		if (std::holds_alternative<IPropertyDataList*>(v)) {
 			printf("ERROR! This type is meant to be internal, never serialized out!");
 			return "";
 		}
+		else if (!names[v.index()].empty()) {
+			return std::string(names[v.index()]);
+		}
 		else {
 			return "UnknownProperty";
 		}
@@ -152,17 +181,18 @@ namespace asset_helper {
 	template<class T>
 	struct has_custom_header<T, typename voider<decltype(T::custom_header)>::type> : std::true_type {};
 
-	void serialize(DataBuffer &buffer, i64 length, PropertyValue &value) {
-		buffer.ctx<AssetCtx>().length = length;
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer, i64 length, PropertyValue &value) {
+		buffer.template ctx<AssetCtx>().length = length;
 
 		std::visit([&](auto &&v) {
 			using T = std::decay_t<decltype(v)>;
 
 			if constexpr (!has_custom_header<T>::value) {
-				if (buffer.ctx<AssetCtx>().parseHeader) {
+				if (buffer.template ctx<AssetCtx>().parseHeader) {
 					u8 dumbheader = 0;
 					buffer.serialize(dumbheader);
-					buffer.ctx<AssetCtx>().headerSize += 1;
+					buffer.template ctx<AssetCtx>().headerSize += 1;
 				}
 			}
 
@@ -178,12 +208,6 @@ namespace asset_helper {
 		}, value);
 	}
 
-	template<class T, class = void>
-	struct has_length : std::false_type {};
-
-	template<class T>
-	struct has_length<T, typename voider<decltype(T::needs_length)>::type> : std::true_type {};
-
 	bool needsLength(const PropertyValue &value) {
 		return std::visit([&](auto &&v) {
 			using T = std::decay_t<decltype(v)>;
@@ -208,15 +232,9 @@ namespace asset_helper {
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-ArrayProperty::~ArrayProperty() {
-	for (auto &&ptr : values) {
-		asset_helper::PropertyValue *value = (asset_helper::PropertyValue *)ptr;
-		delete value;
-	}
-}
-
-void ArrayProperty::serialize(DataBuffer &buffer) {
-	bool parseHeader = buffer.ctx<AssetCtx>().parseHeader;
+template<typename P>
+void ArrayProperty::serialize(PolicyBuffer<P> &buffer) {
+	bool parseHeader = buffer.template ctx<AssetCtx>().parseHeader;
 	if (parseHeader) {
 		size_t headerStart = buffer.pos;
 
@@ -224,42 +242,66 @@ void ArrayProperty::serialize(DataBuffer &buffer) {
 		u8 null = 0;
 		buffer.serialize(null);
 
-		buffer.ctx<AssetCtx>().headerSize += (buffer.pos - headerStart);
+		buffer.template ctx<AssetCtx>().headerSize += (buffer.pos - headerStart);
+	}
+
+	//Only one of typed and values is saved, elements added to the other one would be silently dropped
+	if (!buffer.loading && !std::holds_alternative<std::monostate>(typed) && !values.empty()) {
+		buffer.error("Array of " + std::to_string(this->size()) + " typed elements also has " + std::to_string(values.size()) + " untyped values");
 	}
 
+	i32 size = this->size();
+	buffer.serialize(size);
+
 	if (buffer.loading) {
-		i32 size;
-		buffer.serialize(size);
+		typed = asset_helper::createTypedArray(asset_helper::getTypeId(buffer.template ctx<AssetCtx>(), arrayType));
+	}
+
+	if (!std::holds_alternative<std::monostate>(typed)) {
+		std::visit([&](auto &&elements) {
+			using T = std::decay_t<decltype(elements)>;
+			if constexpr (!std::is_same_v<T, std::monostate>) {
+				buffer.serializeWithSize(elements, size);
+			}
+		}, typed);
+		return;
+	}
+
+	if (buffer.loading) {
+		PropertyArena &arena = *buffer.template ctx<AssetCtx>().arena;
+
+		//Every element has the same type, so only the first one has to look it up
+		asset_helper::PropertyValue prototype;
+		if (size > 0) {
+			prototype = asset_helper::createPropertyValue(buffer.template ctx<AssetCtx>(), arrayType);
+		}
 
 		values.resize(size);
 		for (i32 i = 0; i < size; ++i) {
-			IPropertyValue *value = new IPropertyValue();
-			std::string valueType = buffer.ctx<AssetCtx>().parsingSaveFormat ? arrayType.str : arrayType.getString(*buffer.ctx<AssetCtx>().header);
-			value->v = asset_helper::createPropertyValue(valueType);
+			IPropertyValue *value = arena.create<IPropertyValue>();
+			value->v = prototype;
 
-			buffer.ctx<AssetCtx>().parseHeader = false;
+			buffer.template ctx<AssetCtx>().parseHeader = false;
 			asset_helper::serialize(buffer, 0, value->v);
-			buffer.ctx<AssetCtx>().parseHeader = parseHeader;
+			buffer.template ctx<AssetCtx>().parseHeader = parseHeader;
 
 			values[i] = value;
 		}
 	}
 	else {
-		i32 size = values.size();
-		buffer.serialize(size);
-
 		for (auto &&ptr : values) {
 			asset_helper::PropertyValue *value = (asset_helper::PropertyValue *)ptr;
 
-			buffer.ctx<AssetCtx>().parseHeader = false;
+			buffer.template ctx<AssetCtx>().parseHeader = false;
 			asset_helper::serialize(buffer, 0, *value);
-			buffer.ctx<AssetCtx>().parseHeader = parseHeader;
+			buffer.template ctx<AssetCtx>().parseHeader = parseHeader;
 		}
 	}
 }
 
-void StructProperty::serialize(DataBuffer &buffer) {
-	bool parseHeader = buffer.ctx<AssetCtx>().parseHeader;
+template<typename P>
+void StructProperty::serialize(PolicyBuffer<P> &buffer) {
+	bool parseHeader = buffer.template ctx<AssetCtx>().parseHeader;
 	if (parseHeader) {
 		size_t headerStart = buffer.pos;
 
@@ -268,39 +310,39 @@ void StructProperty::serialize(DataBuffer &buffer) {
 		u8 null = 0;
 		buffer.serialize(null);
 
-		buffer.ctx<AssetCtx>().headerSize += (buffer.pos - headerStart);
+		buffer.template ctx<AssetCtx>().headerSize += (buffer.pos - headerStart);
 	}
 
 	if (buffer.loading) {
-		auto len = buffer.ctx<AssetCtx>().length;
+		auto len = buffer.template ctx<AssetCtx>().length;
 		auto currentPos = buffer.pos;
 
 		do {
-			IPropertyValue *value = new IPropertyValue();
-
-			std::string typeStr = buffer.ctx<AssetCtx>().parsingSaveFormat ? type.str : type.getString(*buffer.ctx<AssetCtx>().header);
-			value->v = asset_helper::createPropertyValue(typeStr, false);
+			PropertyArena &arena = *buffer.template ctx<AssetCtx>().arena;
+			IPropertyValue *value = arena.create<IPropertyValue>();
+			value->v = asset_helper::createPropertyValue(buffer.template ctx<AssetCtx>(), type, false);
 
-			buffer.ctx<AssetCtx>().parseHeader = false;
+			buffer.template ctx<AssetCtx>().parseHeader = false;
 			asset_helper::serialize(buffer, 0, value->v);
-			buffer.ctx<AssetCtx>().parseHeader = parseHeader;
+			buffer.template ctx<AssetCtx>().parseHeader = parseHeader;
 
 			values.emplace_back(value);
 		} while ((buffer.pos - currentPos) < len);
 	}
 	else {
 		for (auto &&value : values) {
-			buffer.ctx<AssetCtx>().parseHeader = false;
+			buffer.template ctx<AssetCtx>().parseHeader = false;
 			asset_helper::serialize(buffer, 0, value->v);
-			buffer.ctx<AssetCtx>().parseHeader = parseHeader;
+			buffer.template ctx<AssetCtx>().parseHeader = parseHeader;
 		}
 	}
 }
 
 
-void MapProperty::serialize(DataBuffer &buffer) {
-	bool parseHeader = buffer.ctx<AssetCtx>().parseHeader;
-	if (buffer.ctx<AssetCtx>().parseHeader) {
+template<typename P>
+void MapProperty::serialize(PolicyBuffer<P> &buffer) {
+	bool parseHeader = buffer.template ctx<AssetCtx>().parseHeader;
+	if (buffer.template ctx<AssetCtx>().parseHeader) {
 		size_t headerStart = buffer.pos;
 
 		buffer.serialize(keyType);
@@ -309,7 +351,7 @@ void MapProperty::serialize(DataBuffer &buffer) {
 		u8 null = 0;
 		buffer.serialize(null);
 
-		buffer.ctx<AssetCtx>().headerSize += (buffer.pos - headerStart);
+		buffer.template ctx<AssetCtx>().headerSize += (buffer.pos - headerStart);
 	}
 
 	i32 usuallyZero = 0;
@@ -319,32 +361,32 @@ void MapProperty::serialize(DataBuffer &buffer) {
 	buffer.serialize(size);
 
 	if (buffer.loading) {
+		PropertyArena &arena = *buffer.template ctx<AssetCtx>().arena;
+
 		map.resize(size);
 		for (i32 i = 0; i < size; ++i) {
 			MapPair pair;
 
 			//Key
 			{
-				IPropertyValue *key = new IPropertyValue();
-				std::string keyTypeStr = buffer.ctx<AssetCtx>().parsingSaveFormat ? keyType.str : keyType.getString(*buffer.ctx<AssetCtx>().header);
-				key->v = asset_helper::createPropertyValue(keyTypeStr);
+				IPropertyValue *key = arena.create<IPropertyValue>();
+				key->v = asset_helper::createPropertyValue(buffer.template ctx<AssetCtx>(), keyType);
 
-				buffer.ctx<AssetCtx>().parseHeader = false;
+				buffer.template ctx<AssetCtx>().parseHeader = false;
 				asset_helper::serialize(buffer, 0, key->v);
-				buffer.ctx<AssetCtx>().parseHeader = parseHeader;
+				buffer.template ctx<AssetCtx>().parseHeader = parseHeader;
 
 				pair.key = key;
 			}
 
 			//Value
 			{
-				IPropertyValue *value = new IPropertyValue();
-				std::string keyTypeStr = buffer.ctx<AssetCtx>().parsingSaveFormat ? valueType.str : valueType.getString(*buffer.ctx<AssetCtx>().header);
-				value->v = asset_helper::createPropertyValue(keyTypeStr);
+				IPropertyValue *value = arena.create<IPropertyValue>();
+				value->v = asset_helper::createPropertyValue(buffer.template ctx<AssetCtx>(), valueType);
 
-				buffer.ctx<AssetCtx>().parseHeader = false;
+				buffer.template ctx<AssetCtx>().parseHeader = false;
 				asset_helper::serialize(buffer, 0, value->v);
-				buffer.ctx<AssetCtx>().parseHeader = parseHeader;
+				buffer.template ctx<AssetCtx>().parseHeader = parseHeader;
 
 				pair.value = value;
 			}
@@ -355,17 +397,63 @@ void MapProperty::serialize(DataBuffer &buffer) {
 	}
 	else {
 		for (auto &&v : map) {
-			buffer.ctx<AssetCtx>().parseHeader = false;
+			buffer.template ctx<AssetCtx>().parseHeader = false;
 			asset_helper::serialize(buffer, 0, v.key->v);
-			buffer.ctx<AssetCtx>().parseHeader = parseHeader;
+			buffer.template ctx<AssetCtx>().parseHeader = parseHeader;
 
-			buffer.ctx<AssetCtx>().parseHeader = false;
+			buffer.template ctx<AssetCtx>().parseHeader = false;
 			asset_helper::serialize(buffer, 0, v.value->v);
-			buffer.ctx<AssetCtx>().parseHeader = parseHeader;
+			buffer.template ctx<AssetCtx>().parseHeader = parseHeader;
 		}
 	}
 }
 
+//The serializers above are only defined here, so they're instantiated here for every policy
+template void asset_helper::serialize(ReadBuffer &, i64, asset_helper::PropertyValue &);
+template void asset_helper::serialize(SizeBuffer &, i64, asset_helper::PropertyValue &);
+template void asset_helper::serialize(WriteBuffer &, i64, asset_helper::PropertyValue &);
+template void asset_helper::serialize(SinkBuffer &, i64, asset_helper::PropertyValue &);
+
+template void ArrayProperty::serialize(ReadBuffer &);
+template void ArrayProperty::serialize(SizeBuffer &);
+template void ArrayProperty::serialize(WriteBuffer &);
+template void ArrayProperty::serialize(SinkBuffer &);
+
+template void StructProperty::serialize(ReadBuffer &);
+template void StructProperty::serialize(SizeBuffer &);
+template void StructProperty::serialize(WriteBuffer &);
+template void StructProperty::serialize(SinkBuffer &);
+
+template void MapProperty::serialize(ReadBuffer &);
+template void MapProperty::serialize(SizeBuffer &);
+template void MapProperty::serialize(WriteBuffer &);
+template void MapProperty::serialize(SinkBuffer &);
+
+
+asset_helper::PropertyValue& PropertyData::getValue(AssetHeader *header, PropertyArena &arena) {
+	if (raw) {
+		value = decodeRaw(header, arena);
+		rawValue = DataBlob();
+		raw = false;
+	}
+
+	return value;
+}
+
+asset_helper::PropertyValue PropertyData::decodeRaw(AssetHeader *header, PropertyArena &arena) const {
+	AssetCtx ctx;
+	ctx.header = header;
+	ctx.arena = &arena;
+
+	ReadBuffer buffer;
+	buffer.ctx_ = &ctx;
+	buffer.buffer = (u8*)rawValue.data();
+	buffer.size = rawValue.size();
+
+	auto decoded = createValue(ctx);
+	asset_helper::serialize(buffer, length, decoded);
+	return decoded;
+}
 
 const std::string& StringRef32::getString(const AssetHeader &header) const {
 	return header.getHeaderRef(ref);
@@ -373,4 +461,243 @@ const std::string& StringRef32::getString(const AssetHeader &header) const {
 
 const std::string& StringRef64::getString(const AssetHeader &header) const {
 	return header.getHeaderRef(ref);
-}
\ No newline at end of file
+}
+
+//Marks every name an asset refers to, for compactNames. Has to reach every ref the asset is saved with.
+struct NameMarker {
+	AssetHeader &header;
+	PropertyArena &arena;
+	std::vector<bool> used;
+
+	//Set on finding bytes a ref could be hidden in
+	bool opaque = false;
+
+	NameMarker(AssetHeader &header, PropertyArena &arena) : header(header), arena(arena), used(header.names.size(), false) {}
+
+	template<typename T>
+	void mark(T ref) {
+		u32 idx = (u32)ref;
+		if (idx < used.size()) {
+			used[idx] = true;
+		}
+	}
+
+	void mark(const StringRef32 &ref) {
+		mark(ref.ref);
+	}
+
+	void mark(const StringRef64 &ref) {
+		mark(ref.ref);
+	}
+
+	//Anything without a name in it
+	template<typename T>
+	void visit(T &) {}
+
+	void visit(UnknownProperty &) {
+		opaque = true;
+	}
+
+	void visit(EnumProperty &v) {
+		mark(v.enumType);
+		mark(v.value);
+	}
+
+	void visit(ByteProperty &v) {
+		mark(v.enumType);
+	}
+
+	void visit(NameProperty &v) {
+		mark(v.name);
+	}
+
+	void visit(SoftObjectProperty &v) {
+		mark(v.name);
+	}
+
+	void visit(IPropertyValue *v) {
+		visit(v->v);
+	}
+
+	void visit(ArrayProperty &v) {
+		mark(v.arrayType);
+		for (auto &&e : v.values) {
+			visit(e);
+		}
+
+		if (auto softObjects = v.view<SoftObjectProperty>()) {
+			for (auto &&e : *softObjects) {
+				visit(e);
+			}
+		}
+	}
+
+	void visit(MapProperty &v) {
+		mark(v.keyType);
+		mark(v.valueType);
+		for (auto &&pair : v.map) {
+			visit(pair.key);
+			visit(pair.value);
+		}
+	}
+
+	void visit(StructProperty &v) {
+		mark(v.type);
+		for (auto &&e : v.values) {
+			visit(e);
+		}
+	}
+
+	//Deferred values are decoded here, the refs in their raw bytes couldn't be remapped on save otherwise
+	void visit(PropertyData &v) {
+		mark(v.nameRef);
+		mark(v.typeRef);
+		visit(v.getValue(&header, arena));
+	}
+
+	void visit(IPropertyDataList *v) {
+		for (auto &&p : v->properties) {
+			visit(p);
+		}
+	}
+
+	void visit(asset_helper::PropertyValue &v) {
+		std::visit([&](auto &&value) {
+			visit(value);
+		}, v);
+	}
+
+	void visit(UObject &v) {
+		visit(&v.data);
+	}
+
+	void visit(DataTableCategory &v) {
+		visit(&v.base.data);
+		mark(v.dataType);
+		for (auto &&e : v.entries) {
+			mark(e.rowName);
+			visit(e.value);
+		}
+	}
+
+	void visit(HmxAssetFile &v) {
+		mark(v.assetName);
+		visit(&v.propList);
+	}
+};
+
+size_t compactNames(AssetHeader &header, AssetData &data) {
+	header.nameRemap.clear();
+
+	//Every property list is saved ending in None, make sure it's there to be kept
+	auto none = header.findOrCreateName("None");
+
+	NameMarker marker(header, data.arena);
+	marker.mark(none);
+
+	for (auto &&l : header.links) {
+		marker.mark(l.base);
+		marker.mark(l.cls);
+		marker.mark(l.property);
+	}
+
+	for (auto &&c : header.catagories) {
+		marker.mark(c.objectName);
+	}
+
+	for (auto &&c : data.catagoryValues) {
+		std::visit([&](auto &&v) {
+			marker.visit(v);
+		}, c.value);
+
+		//Bytes after an export that weren't parsed can hold refs too
+		if (!c.extraData.empty()) {
+			marker.opaque = true;
+		}
+	}
+
+	if (marker.opaque) {
+		return 0;
+	}
+
+	std::vector<i32> remap(header.names.size(), -1);
+	i32 kept = 0;
+	for (size_t i = 0; i < remap.size(); ++i) {
+		if (marker.used[i]) {
+			remap[i] = kept++;
+		}
+	}
+
+	size_t dropped = remap.size() - kept;
+	if (dropped != 0) {
+		header.nameRemap = std::move(remap);
+	}
+	return dropped;
+}
+
+void PakFile::PakEntry::load() {
+	if (!pending) {
+		return;
+	}
+
+	//Decoding the .uexp comes back round to load its header, which is already done by then
+	if (pending->decoding) {
+		return;
+	}
+
+	auto &&pak = *pending->pak;
+
+	//The header goes first, the .uexp needs it
+	PakEntry *header = nullptr;
+	PakEntry *uexp = nullptr;
+	if (name.find(".uasset") != std::string::npos) {
+		header = this;
+		uexp = pak.findEntry(name.substr(0, name.size() - 7) + ".uexp");
+	}
+	else if (name.find(".uexp") != std::string::npos) {
+		header = pak.findEntry(name.substr(0, name.size() - 5) + ".uasset");
+		uexp = this;
+	}
+	else {
+		//Not an asset, it's only ever saved back as its bytes
+		return;
+	}
+
+	std::vector<PakEntry*> pair;
+	for (auto e : { header, uexp }) {
+		if (e && e->pending) {
+			e->pending->decoding = true;
+			pair.push_back(e);
+		}
+	}
+
+	try {
+		for (auto e : pair) {
+			auto &&p = *e->pending;
+
+			ReadBuffer assetBuffer;
+			assetBuffer.source = p.bytes.viewSource();
+			assetBuffer.throwOnError = p.throwOnError;
+			assetBuffer.buffer = (u8*)p.bytes.data();
+			assetBuffer.size = p.bytes.size();
+			e->decode(assetBuffer, pak);
+		}
+	}
+	catch (...) {
+		for (auto e : pair) {
+			e->pending->decoding = false;
+		}
+		throw;
+	}
+
+	//A .uexp without a header to go with it has nothing to decode into, so it stays as its bytes
+	bool decoded = uexp == nullptr || std::holds_alternative<PakAssetData>(uexp->data);
+	for (auto e : pair) {
+		if (decoded) {
+			e->pending.reset();
+		}
+		else {
+			e->pending->decoding = false;
+		}
+	}
+}
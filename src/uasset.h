@@ -1,13 +1,32 @@
+#pragma once
 #include "core_types.h"
 #include "serialize.h"
 #include "sha1.h"
 #include "crc.h"
 #include "hmx_midifile.h"
+#include "property_arena.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <unordered_map>
 
 struct AssetHeader;
 
 struct BaseCtx {
 	bool useStringRef = true;
+
+	//Set while saving an asset whose unused names are being left out, see compactNames
+	const std::vector<i32> *nameRemap = nullptr;
+
+	//Where a name ref points once the table is compacted. Only the low 32 bits are an index, the rest is the name's number.
+	template<typename T>
+	T remapName(T ref) const {
+		u32 idx = (u32)ref;
+		if (nameRemap == nullptr || idx >= nameRemap->size()) {
+			return ref;
+		}
+		return (T)(((u64)ref & 0xFFFFFFFF00000000ull) | (u32)(*nameRemap)[idx]);
+	}
 };
 
 struct UnrealName {
@@ -15,7 +34,8 @@ struct UnrealName {
 	i16 nonCasePreservingHash;
 	i16 casePreservingHash;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(name);
 		buffer.serialize(nonCasePreservingHash);
 		buffer.serialize(casePreservingHash);
@@ -25,9 +45,7 @@ struct UnrealName {
 struct Guid {
 	char guid[16];
 
-	void serialize(DataBuffer &buffer) {
-		buffer.serialize(guid);
-	}
+	static constexpr size_t fixed_layout_size = 16;
 };
 
 struct Link {
@@ -36,7 +54,8 @@ struct Link {
 	i32 link;
 	u64 property;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(base);
 		buffer.serialize(cls);
 		buffer.serialize(link);
@@ -68,9 +87,17 @@ struct StringRef32 {
 		}
 	}
 
-	void serialize(DataBuffer &buffer) {
-		if (buffer.ctx<BaseCtx>().useStringRef) {
-			buffer.serialize(ref);
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		auto &&ctx = buffer.template ctx<BaseCtx>();
+		if (ctx.useStringRef) {
+			if (!buffer.loading && ctx.nameRemap) {
+				auto remapped = ctx.remapName(ref);
+				buffer.serialize(remapped);
+			}
+			else {
+				buffer.serialize(ref);
+			}
 		}
 		else {
 			buffer.serialize(str);
@@ -95,9 +122,17 @@ struct StringRef64 {
 		}
 	}
 
-	void serialize(DataBuffer &buffer) {
-		if (buffer.ctx<BaseCtx>().useStringRef) {
-			buffer.serialize(ref);
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		auto &&ctx = buffer.template ctx<BaseCtx>();
+		if (ctx.useStringRef) {
+			if (!buffer.loading && ctx.nameRemap) {
+				auto remapped = ctx.remapName(ref);
+				buffer.serialize(remapped);
+			}
+			else {
+				buffer.serialize(ref);
+			}
 		}
 		else {
 			buffer.serialize(str);
@@ -133,7 +168,8 @@ struct Catagory {
 	i32 serializationBeforeCreateDependencies;
 	i32 createBeforeCreateDependencies;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(classIdx);
 		buffer.serialize(superIdx);
 		
@@ -168,7 +204,8 @@ struct Catagory {
 struct CatagoryRef {
 	std::vector<i32> data;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(data);
 	}
 };
@@ -180,7 +217,8 @@ struct Version {
 	i32 changelist;
 	std::string branch;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(major);
 		buffer.serialize(minor);
 		buffer.serialize(patch);
@@ -192,10 +230,8 @@ struct Version {
 struct CustomVersion {
 	Guid key;
 	i32 version;
-	void serialize(DataBuffer &buffer) {
-		buffer.serialize(key);
-		buffer.serialize(version);
-	}
+
+	static constexpr size_t fixed_layout_size = 20;
 };
 
 struct AssetHeader {
@@ -229,10 +265,7 @@ struct AssetHeader {
 		i32 exportCount;
 		i32 nameCount;
 
-		void serialize(DataBuffer &buffer) {
-			buffer.serialize(exportCount);
-			buffer.serialize(nameCount);
-		}
+		static constexpr size_t fixed_layout_size = 8;
 	};
 	std::vector<Generation> generations;
 
@@ -243,9 +276,7 @@ struct AssetHeader {
 	struct CompressedChunk {
 		i32 data[4];
 
-		void serialize(DataBuffer &buffer) {
-			buffer.serialize(data);
-		}
+		static constexpr size_t fixed_layout_size = 16;
 	};
 	std::vector<CompressedChunk> compressedChunks;
 
@@ -270,8 +301,11 @@ struct AssetHeader {
 	std::vector<i32> uexpData;
 	std::vector<i32> preloadDependencies;
 
+	//Position of each name in the saved table, or -1 for one left out. Empty saves every name. Set up by compactNames (volatile)
+	std::vector<i32> nameRemap;
+
 	const Link& getLinkRef(i32 idx) const {
-		if (idx < 0) {
+		if (idx < 0 && (size_t)-(idx + 1) < links.size()) {
 			return links[-(idx + 1)];
 		}
 		else {
@@ -283,17 +317,16 @@ struct AssetHeader {
 	const std::string& getHeaderRef(i32 ref) const {
 		static std::string BAD_STRING = "BAD";
 		if (ref < 0) return BAD_STRING;
-		if (ref > names.size()) BAD_STRING;
+		if (ref >= names.size()) return BAD_STRING;
 		return names[ref].name;
 	}
 
 	StringRef32 findOrCreateName(const std::string &str) {
-		for (size_t i = 0; i < names.size(); ++i) {
-			if (names[i].name == str) {
-				StringRef32 r;
-				r.ref = i;
-				return r;
-			}
+		i32 found = findNameIndex(str);
+		if (found != -1) {
+			StringRef32 r;
+			r.ref = found;
+			return r;
 		}
 
 		auto idx = names.size();
@@ -307,22 +340,39 @@ struct AssetHeader {
 	}
 
 	StringRef32 findName(const std::string &str) {
-		for (size_t i = 0; i < names.size(); ++i) {
-			if (names[i].name == str) {
-				StringRef32 r;
-				r.ref = i;
-				return r;
-			}
-		}
+		i32 found = findNameIndex(str);
 
 		StringRef32 r;
-		r.ref = std::numeric_limits<i32>::max();
+		r.ref = found != -1 ? found : std::numeric_limits<i32>::max();
 		return r;
 	}
 
-	void serialize(DataBuffer &buffer) {
+	//Names should be changed through here so lookups keep finding them, see nameIndex
+	void setName(i32 ref, const std::string &str) {
+		updateNameIndex();
+
+		auto range = nameIndex.equal_range(std::hash<std::string>{}(names[ref].name));
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second == ref) {
+				nameIndex.erase(it);
+				break;
+			}
+		}
+
+		names[ref].name = str;
+		nameIndex.emplace(std::hash<std::string>{}(str), ref);
+	}
+
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		if (!buffer.loading) {
 			nameCount = names.size();
+			if (!nameRemap.empty()) {
+				nameCount = 0;
+				for (auto &&r : nameRemap) {
+					nameCount += r != -1;
+				}
+			}
 
 			if (generations.size() > 0) {
 				generations[0].exportCount = exportsCount;
@@ -334,7 +384,7 @@ struct AssetHeader {
 
 		buffer.serialize(magic);
 		if (magic != 0x9E2A83C1) {
-			__debugbreak();
+			buffer.error("Bad asset header magic");
 			return;
 		}
 
@@ -395,7 +445,42 @@ struct AssetHeader {
 		};
 
 		jumpOrSetOffset(nameOffset);
-		buffer.serializeWithSize(names, nameCount);
+		if (!buffer.loading && !nameRemap.empty()) {
+			std::vector<UnrealName> kept;
+			kept.reserve(nameCount);
+			for (size_t i = 0; i < names.size() && i < nameRemap.size(); ++i) {
+				if (nameRemap[i] != -1) {
+					kept.emplace_back(names[i]);
+				}
+			}
+			buffer.serializeWithSize(kept, nameCount);
+		}
+		else {
+			buffer.serializeWithSize(names, nameCount);
+		}
+		if (buffer.loading) {
+			invalidateNameIndex();
+		}
+
+		//The tables keep pointing into the full name table, they're only remapped for as long as they're being written
+		BaseCtx remapCtx;
+		std::vector<Link> fullLinks;
+		std::vector<u64> fullObjectNames;
+		if (!buffer.loading && !nameRemap.empty()) {
+			remapCtx.nameRemap = &nameRemap;
+
+			fullLinks = links;
+			for (auto &&l : links) {
+				l.base = remapCtx.remapName(l.base);
+				l.cls = remapCtx.remapName(l.cls);
+				l.property = remapCtx.remapName(l.property);
+			}
+
+			for (auto &&c : catagories) {
+				fullObjectNames.emplace_back(c.objectName);
+				c.objectName = remapCtx.remapName(c.objectName);
+			}
+		}
 
 		jumpOrSetOffset(importOffset);
 		buffer.serializeWithSize(links, importCount);
@@ -403,6 +488,13 @@ struct AssetHeader {
 		jumpOrSetOffset(exportsOffset);
 		buffer.serializeWithSize(catagories, exportsCount);
 
+		if (remapCtx.nameRemap) {
+			links = std::move(fullLinks);
+			for (size_t i = 0; i < catagories.size(); ++i) {
+				catagories[i].objectName = fullObjectNames[i];
+			}
+		}
+
 		jumpOrSetOffset(dependenciesOffset);
 		buffer.serializeWithSize(catagoryGroups, exportsCount);
 
@@ -421,6 +513,41 @@ struct AssetHeader {
 
 		if (!buffer.loading) totalHeaderSize = buffer.pos;
 	}
+
+private:
+	//Hash of each name to its index. Names appended to the table are picked up on the next lookup,
+	//renames have to go through setName.
+	std::unordered_multimap<size_t, i32> nameIndex;
+	size_t indexedNames = 0;
+
+	void invalidateNameIndex() {
+		nameIndex.clear();
+		indexedNames = 0;
+	}
+
+	void updateNameIndex() {
+		if (indexedNames > names.size()) {
+			invalidateNameIndex();
+		}
+
+		for (; indexedNames < names.size(); ++indexedNames) {
+			nameIndex.emplace(std::hash<std::string>{}(names[indexedNames].name), (i32)indexedNames);
+		}
+	}
+
+	//First index holding str, or -1
+	i32 findNameIndex(const std::string &str) {
+		updateNameIndex();
+
+		i32 found = -1;
+		auto range = nameIndex.equal_range(std::hash<std::string>{}(str));
+		for (auto it = range.first; it != range.second; ++it) {
+			if (names[it->second].name == str && (found == -1 || it->second < found)) {
+				found = it->second;
+			}
+		}
+		return found;
+	}
 };
 
 ///////////////////////////////////////////////////////////////
@@ -432,13 +559,27 @@ struct AssetCtx {
 	bool parseHeader = true;
 	u32 headerSize = 0;
 	bool parsingSaveFormat = false;
+
+	//Where values of a property tree are created while loading, owned by the AssetData or SaveFile being parsed
+	PropertyArena *arena = nullptr;
+
+	//Property type of each header name, filled in the first time a name is used as a type during this parse
+	static constexpr u8 TYPE_NOT_LOOKED_UP = 0xFE;
+	std::vector<u8> nameTypeIds;
+
+	//Keep property values as their raw bytes until they're asked for, see PropertyData::getValue
+	bool deferProperties = false;
 };
 
 template<typename T>
 struct PrimitiveProperty {
 	T data;
 
-	void serialize(DataBuffer &buffer) {
+	//Just the value as it is in the file, so an array of them is copied as one block
+	static constexpr size_t fixed_layout_size = sizeof(T);
+
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(data);
 	}
 };
@@ -449,7 +590,8 @@ struct TextProperty {
 	u64 extras;
 	std::vector<std::string> strings;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(flag);
 		buffer.serialize(historyType);
 
@@ -472,7 +614,8 @@ struct TextProperty {
 struct StringProperty {
 	std::string str;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(str);
 	}
 };
@@ -482,10 +625,11 @@ struct ObjectProperty {
 
 	StringRef32 type;
 	StringRef32 value;
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(linkVal);
 
-		if (buffer.ctx<AssetCtx>().parsingSaveFormat) {
+		if (buffer.template ctx<AssetCtx>().parsingSaveFormat) {
 			buffer.serialize(type);
 			buffer.serialize(value);
 		}
@@ -494,20 +638,22 @@ struct ObjectProperty {
 
 struct EnumProperty {
 	static const bool custom_header = true;
+	static const size_t tag_size = 9;
 
 	StringRef64 enumType;
 	u8 blank;
 	StringRef64 value;
 
 
-	void serialize(DataBuffer &buffer) {
-		if (buffer.ctx<AssetCtx>().parseHeader) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		if (buffer.template ctx<AssetCtx>().parseHeader) {
 			size_t headerStart = buffer.pos;
 
 			buffer.serialize(enumType);
 			buffer.serialize(blank);
 
-			buffer.ctx<AssetCtx>().headerSize += (buffer.pos - headerStart);
+			buffer.template ctx<AssetCtx>().headerSize += (buffer.pos - headerStart);
 		}
 
 		buffer.serialize(value);
@@ -518,8 +664,9 @@ struct NameProperty {
 	StringRef32 name;
 	u32 v;
 
-	void serialize(DataBuffer &buffer) {
-		if (!buffer.ctx<AssetCtx>().parsingSaveFormat) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		if (!buffer.template ctx<AssetCtx>().parsingSaveFormat) {
 			buffer.serialize(name);
 			buffer.serialize(v);
 		}
@@ -529,32 +676,66 @@ struct NameProperty {
 	}
 };
 
-struct IPropertyValue;
+struct SoftObjectProperty {
+	StringRef32 name;
+	u64 value;
 
-struct ArrayProperty {
-	ArrayProperty() {}
-	ArrayProperty(ArrayProperty &&rhs) {
-		arrayType = std::move(rhs.arrayType);
-		values = std::move(rhs.values);
-		rhs.values.clear();
-	}
-	ArrayProperty& operator=(ArrayProperty&& rhs) {
-		arrayType = std::move(rhs.arrayType);
-		values = std::move(rhs.values);
-		rhs.values.clear();
-		return *this;
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		buffer.serialize(name);
+
+		if (buffer.template ctx<AssetCtx>().parsingSaveFormat) {
+			u32 smolValue = value;
+			buffer.serialize(smolValue);
+			value = smolValue;
+		}
+		else {
+			buffer.serialize(value);
+		}
 	}
+};
+
+struct IPropertyValue;
 
+struct ArrayProperty {
 	static const bool custom_header = true;
+	static const size_t tag_size = 9;
 	StringRef64 arrayType;
+
+	//Arrays of numbers, guids and object references keep their elements together in typed (see view),
+	//arrays of anything else have a value per element here
 	std::vector<IPropertyValue*> values;
 
-	~ArrayProperty();
-	void serialize(DataBuffer &buffer);
+	using TypedValues = std::variant<std::monostate, std::vector<PrimitiveProperty<i8>>, std::vector<PrimitiveProperty<i16>>, std::vector<PrimitiveProperty<i32>>, std::vector<PrimitiveProperty<i64>>,
+									 std::vector<PrimitiveProperty<u16>>, std::vector<PrimitiveProperty<u32>>, std::vector<PrimitiveProperty<u64>>, std::vector<PrimitiveProperty<float>>,
+									 std::vector<PrimitiveProperty<Guid>>, std::vector<ObjectProperty>, std::vector<SoftObjectProperty>>;
+	TypedValues typed;
+
+	//The elements, if this is an array of T
+	template<typename T>
+	std::vector<T>* view() {
+		return std::get_if<std::vector<T>>(&typed);
+	}
+
+	size_t size() const {
+		return std::visit([&](auto &&elements) -> size_t {
+			using T = std::decay_t<decltype(elements)>;
+			if constexpr (std::is_same_v<T, std::monostate>) {
+				return values.size();
+			}
+			else {
+				return elements.size();
+			}
+		}, typed);
+	}
+
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer);
 };
 
 struct MapProperty {
 	static const bool custom_header = true;
+	static const size_t tag_size = 17;
 	StringRef64 keyType;
 	StringRef64 valueType;
 
@@ -564,45 +745,50 @@ struct MapProperty {
 	};
 	std::vector<MapPair> map;
 
-	void serialize(DataBuffer &buffer);
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer);
 };
 
 struct StructProperty {
 	static const bool custom_header = true;
 	static const bool needs_length = true;
+	static const size_t tag_size = 25;
 
 	Guid guid;
 	StringRef64 type;
 	std::vector<IPropertyValue*> values;
 
-	void serialize(DataBuffer &buffer);
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer);
 	IPropertyValue *get(const std::string &name);
 };
 
 struct ByteProperty {
 	static const bool custom_header = true;
+	static const size_t tag_size = 9;
 
 	StringRef64 enumType;
 	i32 byteType;
 	i32 value;
 
-	void serialize(DataBuffer &buffer) {
-		if (buffer.ctx<AssetCtx>().parseHeader) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		if (buffer.template ctx<AssetCtx>().parseHeader) {
 			size_t headerStart = buffer.pos;
 
 			buffer.serialize(enumType);
 			u8 null;
 			buffer.serialize(null);
 
-			buffer.ctx<AssetCtx>().headerSize += (headerStart - buffer.pos);
+			buffer.template ctx<AssetCtx>().headerSize += (headerStart - buffer.pos);
 		}
 
-		if (buffer.ctx<AssetCtx>().length == 1) {
+		if (buffer.template ctx<AssetCtx>().length == 1) {
 			u8 v = value;
 			buffer.serialize(v);
 			value = v;
 		}
-		else if (buffer.ctx<AssetCtx>().length == 8 || buffer.ctx<AssetCtx>().length == 0) {
+		else if (buffer.template ctx<AssetCtx>().length == 8 || buffer.template ctx<AssetCtx>().length == 0) {
 			u64 v = value;
 			buffer.serialize(v);
 			value = v;
@@ -610,32 +796,16 @@ struct ByteProperty {
 	}
 };
 
-struct SoftObjectProperty {
-	StringRef32 name;
-	u64 value;
-
-	void serialize(DataBuffer &buffer) {
-		buffer.serialize(name);
-
-		if (buffer.ctx<AssetCtx>().parsingSaveFormat) {
-			u32 smolValue = value;
-			buffer.serialize(smolValue);
-			value = smolValue;
-		}
-		else {
-			buffer.serialize(value);
-		}
-	}
-};
-
 struct BoolProperty {
 	static const bool custom_header = true;
+	static const size_t tag_size = 2;
 	bool value;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(value);
 
-		if (buffer.ctx<AssetCtx>().parseHeader) {
+		if (buffer.template ctx<AssetCtx>().parseHeader) {
 			u8 null = 0;
 			buffer.serialize(null);
 		}
@@ -645,7 +815,8 @@ struct BoolProperty {
 struct DateTime {
 	u64 time;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(time);
 	}
 };
@@ -655,10 +826,11 @@ struct IPropertyDataList;
 struct UnknownProperty {
 	static const bool needs_length = true;
 
-	std::vector<u8> data;
+	DataBlob data;
 
-	void serialize(DataBuffer &buffer) {
-		buffer.serializeWithSize(data, (size_t)buffer.ctx<AssetCtx>().length);
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		buffer.serializeWithSize(data, (size_t)buffer.template ctx<AssetCtx>().length);
 	}
 };
 
@@ -666,10 +838,28 @@ namespace asset_helper {
 	using PropertyValue = std::variant<UnknownProperty, BoolProperty, PrimitiveProperty<i8>, PrimitiveProperty<i16>, PrimitiveProperty<i32>, PrimitiveProperty<i64>, PrimitiveProperty<u16>, PrimitiveProperty<u32>, PrimitiveProperty<u64>, PrimitiveProperty<float>,
 									   TextProperty, StringProperty, ObjectProperty, EnumProperty, ByteProperty, NameProperty, ArrayProperty, MapProperty, StructProperty, PrimitiveProperty<Guid>, SoftObjectProperty, IPropertyDataList*, DateTime>;
 
-	PropertyValue createPropertyValue(const std::string &type, const bool useUnknown = true);
+	//Position of a type in the property factory table, so parsing can create values without comparing type names
+	using PropertyTypeId = u8;
+	const PropertyTypeId UNKNOWN_PROPERTY_TYPE = 0xFF;
+
+	PropertyTypeId getTypeId(std::string_view type);
+	PropertyTypeId getTypeId(AssetCtx &ctx, const StringRef32 &type);
+	PropertyTypeId getTypeId(AssetCtx &ctx, const StringRef64 &type);
+
+	//Bytes between a property's length and its value, which aren't counted in the length
+	size_t getTagSize(PropertyTypeId type);
+
+	//Whether a property's length can be trusted to skip over its value. Only types that get their length
+	//rewritten on save qualify, older saves of ours left stale lengths on the rest (edited TextProperty titles for one).
+	bool canDefer(PropertyTypeId type);
+
+	PropertyValue createPropertyValue(PropertyTypeId type, PropertyArena &arena, const bool useUnknown = true);
+	PropertyValue createPropertyValue(AssetCtx &ctx, const StringRef32 &type, const bool useUnknown = true);
+	PropertyValue createPropertyValue(AssetCtx &ctx, const StringRef64 &type, const bool useUnknown = true);
 	std::string getTypeForValue(const PropertyValue &v);
 
-	void serialize(DataBuffer &buffer, i64 length, PropertyValue &value);
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer, i64 length, PropertyValue &value);
 
 	bool needsLength(const PropertyValue &value);
 
@@ -686,15 +876,33 @@ struct PropertyData {
 	i32 widgetData = 0;
 	StringRef64 typeRef;
 	i64 length = 0;
-	asset_helper::PropertyValue value;
 	bool isNone = false;
 
-	void serialize(DataBuffer &buffer) {
-		auto headerPtr = buffer.ctx<AssetCtx>().header;
+	//Values loaded with deferProperties are decoded here the first time they're asked for.
+	//header and arena have to be the ones of the asset the property was loaded from.
+	asset_helper::PropertyValue& getValue(AssetHeader *header, PropertyArena &arena);
+
+	//Decodes the raw bytes into a separate value, leaving the property raw so it's still saved back verbatim
+	asset_helper::PropertyValue decodeRaw(AssetHeader *header, PropertyArena &arena) const;
+
+	void setValue(asset_helper::PropertyValue &&v) {
+		value = std::move(v);
+		rawValue = DataBlob();
+		raw = false;
+	}
+
+	//Still the bytes it was loaded from, in which case it's saved back out exactly as it was
+	bool isRaw() const {
+		return raw;
+	}
+
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		auto headerPtr = buffer.template ctx<AssetCtx>().header;
 
 		buffer.serialize(nameRef);
 
-		if (!buffer.ctx<AssetCtx>().parsingSaveFormat) {
+		if (!buffer.template ctx<AssetCtx>().parsingSaveFormat) {
 			buffer.serialize(widgetData);
 
 			if (nameRef.getString(*headerPtr) == "None" || nameRef.ref == 0) {
@@ -714,37 +922,63 @@ struct PropertyData {
 
 
 		if (buffer.loading) {
-			std::string type;
-
-			if (!buffer.ctx<AssetCtx>().parsingSaveFormat) {
-				type = nameRef.getString(*headerPtr);
-				if (typeRef.ref > 0) {
-					type = typeRef.getString(*headerPtr);
+			auto &&ctx = buffer.template ctx<AssetCtx>();
+			auto type = ctx.parsingSaveFormat ? asset_helper::UNKNOWN_PROPERTY_TYPE : getTypeId(ctx);
+			if (ctx.deferProperties && asset_helper::canDefer(type)) {
+				size_t rawSize = asset_helper::getTagSize(type) + length;
+				if (length < 0 || buffer.pos + rawSize > buffer.size) {
+					buffer.error("Property " + nameRef.getString(*headerPtr) + " runs past the end of its data");
+					return;
 				}
-			}
-			else {
-				type = typeRef.str;
+
+				buffer.serializeWithSize(rawValue, rawSize);
+				raw = true;
+				return;
 			}
 
-			value = asset_helper::createPropertyValue(type);
+			value = createValue(ctx);
+		}
+		else if (raw) {
+			buffer.serializeWithSize(rawValue, rawValue.size());
+			return;
 		}
 
 		size_t beforeProp = buffer.pos;
-		auto prevSize = buffer.ctx<AssetCtx>().headerSize;
+		auto prevSize = buffer.template ctx<AssetCtx>().headerSize;
 
-		buffer.ctx<AssetCtx>().headerSize = 0;
+		buffer.template ctx<AssetCtx>().headerSize = 0;
 		asset_helper::serialize(buffer, length, value);
 
 		if (!buffer.loading && asset_helper::needsLength(value)) {
 			size_t finalPos = buffer.pos;
-			length = (finalPos - beforeProp) - buffer.ctx<AssetCtx>().headerSize;
+			length = (finalPos - beforeProp) - buffer.template ctx<AssetCtx>().headerSize;
 			buffer.pos = beforeProp - sizeof(length);
 			buffer.serialize(length);
 			buffer.pos = finalPos;
 
 		}
 
-		buffer.ctx<AssetCtx>().headerSize = prevSize;
+		buffer.template ctx<AssetCtx>().headerSize = prevSize;
+	}
+
+private:
+	asset_helper::PropertyValue value;
+	DataBlob rawValue;
+	bool raw = false;
+
+	//Older properties leave typeRef empty and are named after their type
+	asset_helper::PropertyTypeId getTypeId(AssetCtx &ctx) const {
+		if (!ctx.parsingSaveFormat && typeRef.ref <= 0) {
+			return asset_helper::getTypeId(ctx, nameRef);
+		}
+		return asset_helper::getTypeId(ctx, typeRef);
+	}
+
+	asset_helper::PropertyValue createValue(AssetCtx &ctx) const {
+		if (!ctx.parsingSaveFormat && typeRef.ref <= 0) {
+			return asset_helper::createPropertyValue(ctx, nameRef);
+		}
+		return asset_helper::createPropertyValue(ctx, typeRef);
 	}
 };
 
@@ -752,28 +986,61 @@ struct IPropertyDataList {
 	std::vector<PropertyData> properties;
 
 	PropertyData* get(StringRef32 name) {
-		for (auto &&p : properties) {
-			if (p.nameRef == name) {
-				return &p;
+		//Save files name their properties with strings, there's no ref to look up
+		if (!name.str.empty()) {
+			for (auto &&p : properties) {
+				if (p.nameRef == name) {
+					return &p;
+				}
 			}
+
+			return nullptr;
+		}
+
+		updateIndex();
+		auto it = index.find(name.ref);
+		if (it == index.end()) {
+			return nullptr;
 		}
 
-		return nullptr;
+		return &properties[it->second];
 	}
 
 	PropertyData* get(AssetHeader *header, const std::string &name) {
-		for (auto &&p : properties) {
-			if (p.nameRef.getString(header) == name) {
-				return &p;
+		if (header == nullptr) {
+			for (auto &&p : properties) {
+				if (p.nameRef.str == name) {
+					return &p;
+				}
 			}
+
+			return nullptr;
 		}
 
-		return nullptr;
+		auto ref = header->findName(name);
+		if (ref.ref == std::numeric_limits<i32>::max()) {
+			return nullptr;
+		}
+
+		return get(ref);
 	}
 
-	void serialize(DataBuffer &buffer) {
-		bool parseHeader = buffer.ctx<AssetCtx>().parseHeader;
-		buffer.ctx<AssetCtx>().parseHeader = true;
+	//p has to be one of this list's properties
+	void rename(PropertyData &p, StringRef32 name) {
+		p.nameRef = name;
+		invalidateIndex();
+	}
+
+	//Needed after removing or reordering properties. Appended ones are picked up on their own, renames go through rename().
+	void invalidateIndex() {
+		index.clear();
+		indexed = 0;
+	}
+
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		bool parseHeader = buffer.template ctx<AssetCtx>().parseHeader;
+		buffer.template ctx<AssetCtx>().parseHeader = true;
 
 		if (buffer.loading) {
 			bool keepParsing = true;
@@ -801,14 +1068,30 @@ struct IPropertyDataList {
 			buffer.serialize(null);
 		}
 
-		buffer.ctx<AssetCtx>().parseHeader = parseHeader;
+		buffer.template ctx<AssetCtx>().parseHeader = parseHeader;
+	}
+
+private:
+	//Name ref of each property to its position, the first one wins if a name is repeated
+	std::unordered_map<i32, size_t> index;
+	size_t indexed = 0;
+
+	void updateIndex() {
+		if (indexed > properties.size()) {
+			invalidateIndex();
+		}
+
+		for (; indexed < properties.size(); ++indexed) {
+			index.emplace(properties[indexed].nameRef.ref, indexed);
+		}
 	}
 };
 
 struct UObject {
 	IPropertyDataList data;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(data);
 	}
 };
@@ -822,7 +1105,8 @@ struct DataTableCategory {
 		i32 duplicateId;
 		StructProperty value;
 
-		void serialize(DataBuffer &buffer) {
+		template<typename P>
+		void serialize(PolicyBuffer<P> &buffer) {
 			buffer.serialize(rowName);
 			buffer.serialize(duplicateId);
 			buffer.serialize(value);
@@ -831,15 +1115,16 @@ struct DataTableCategory {
 
 	std::vector<Entry> entries;
 
-	void serialize(DataBuffer &buffer) {
-		auto &&header = *buffer.ctx<AssetCtx>().header;
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		auto &&header = *buffer.template ctx<AssetCtx>().header;
 		buffer.serialize(base);
 
 		
 		if(buffer.loading) {
 			for (auto &&p : base.data.properties) {
 				if (p.nameRef.getString(header) == "RowStruct") {
-					if (auto objPtr = std::get_if<ObjectProperty>(&p.value)) {
+					if (auto objPtr = std::get_if<ObjectProperty>(&p.getValue(&header, *buffer.template ctx<AssetCtx>().arena))) {
 						dataType.ref = header.getLinkRef(objPtr->linkVal).property;
 						break;
 					}
@@ -853,9 +1138,9 @@ struct DataTableCategory {
 		i32 size = entries.size();
 		buffer.serialize(size);
 
-		bool parseHeader = buffer.ctx<AssetCtx>().parseHeader;
-		buffer.ctx<AssetCtx>().parseHeader = false;
-		buffer.ctx<AssetCtx>().length = 0;
+		bool parseHeader = buffer.template ctx<AssetCtx>().parseHeader;
+		buffer.template ctx<AssetCtx>().parseHeader = false;
+		buffer.template ctx<AssetCtx>().length = 0;
 		if (buffer.loading) {
 			for (i32 i = 0; i < size; ++i) {
 				Entry e;
@@ -868,7 +1153,7 @@ struct DataTableCategory {
 		else {
 			buffer.serializeWithSize(entries, size);
 		}
-		buffer.ctx<AssetCtx>().parseHeader = parseHeader;
+		buffer.template ctx<AssetCtx>().parseHeader = parseHeader;
 	}
 };
 
@@ -892,16 +1177,7 @@ struct HmxAudio {
 			u32 maybe_channels2;
 			u32 moggSize;
 
-			void serialize(DataBuffer &buffer) {
-				buffer.serialize(identifier);
-				buffer.serialize(unk1_samples);
-				buffer.serialize(sample_rate);
-				buffer.serialize(maybe_channels);
-				buffer.serialize(numberOfSamples);
-				buffer.serialize(unk2);
-				buffer.serialize(maybe_channels2);
-				buffer.serialize(moggSize);
-			}
+			static constexpr size_t fixed_layout_size = 32;
 		};
 
 		struct MidiMusicResource {
@@ -916,7 +1192,8 @@ struct HmxAudio {
 			hmx_string patch_engine_path;
 			i32 unk5;
 
-			void serialize(DataBuffer &buffer) {
+			template<typename P>
+			void serialize(PolicyBuffer<P> &buffer) {
 				buffer.serialize(unk);
 				buffer.serialize(midisong_name);
 				buffer.serialize(root);
@@ -933,16 +1210,18 @@ struct HmxAudio {
 		struct FusionFileResource {
 			hmx_fusion_nodes nodes;
 
-			void serialize(DataBuffer &buffer) {
+			template<typename P>
+			void serialize(PolicyBuffer<P> &buffer) {
 				
 			}
 		};
 
 		std::variant<std::monostate, MoggSampleResourceHeader, MidiMusicResource, FusionFileResource> resourceHeader;
-		std::vector<u8> fileData;
+		DataBlob fileData;
 
 
-		void serialize(DataBuffer &buffer) {
+		template<typename P>
+		void serialize(PolicyBuffer<P> &buffer) {
 			buffer.serialize(unk0);
 			buffer.serialize(fileName);
 			buffer.serialize(null);
@@ -963,8 +1242,14 @@ struct HmxAudio {
 				}
 				else if (fileType == "FusionPatchResource") {
 					FusionFileResource resource;
+					size_t fusionStart = buffer.rootPos();
 					buffer.serializeWithSize(fileData, totalSize);
-					resource.nodes = hmx_fusion_parser::parseData(fileData);
+					try {
+						resource.nodes = hmx_fusion_parser::parseData(fileData.data(), fileData.size(), buffer.throwOnError);
+					}
+					catch (const ParseError &e) {
+						buffer.error(e.what(), fusionStart + e.offset);
+					}
 					resourceHeader = std::move(resource);
 				}
 				else {
@@ -987,10 +1272,7 @@ struct HmxAudio {
 
 				if (auto fusionResource = std::get_if<FusionFileResource>(&resourceHeader)) {
 					auto str = hmx_fusion_parser::outputData(fusionResource->nodes);
-
-					fileData.clear();
-					fileData.resize(str.size());
-					std::memcpy(fileData.data(), str.data(), fileData.size());
+					fileData = std::vector<u8>(str.begin(), str.end());
 				}
 
 				buffer.serializeWithSize(fileData, fileData.size());
@@ -1003,7 +1285,8 @@ struct HmxAudio {
 	i64 numAudioFiles;
 	std::vector<PackageFile> audioFiles;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		numAudioFiles = audioFiles.size();
 
 		buffer.serialize(numAudioFiles);
@@ -1024,7 +1307,8 @@ struct HmxAssetFile {
 
 	HmxAudio audio;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(assetName);
 		buffer.serialize(propList);
 		buffer.serialize(null);
@@ -1058,12 +1342,13 @@ struct HmxFusionAsset {
 
 	HmxAudio audio;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(unkName0);
 		buffer.serialize(unkName1);
 
 		if (unkName1.ref != 7) {
-			__debugbreak();
+			buffer.error("Unexpected name in HMX asset file");
 		}
 
 		buffer.serialize(propName);
@@ -1090,7 +1375,8 @@ struct HmxMidiSongAsset {
 
 	HmxAudio audio;
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(unkName0);
 		buffer.serialize(propList);
 		buffer.serialize(somethign);
@@ -1108,71 +1394,77 @@ struct AssetData {
 		using CatagoryVariant = std::variant<UObject, DataTableCategory, HmxAssetFile>;
 
 		CatagoryVariant value;
-		std::vector<u8> extraData;
+		DataBlob extraData;
 	};
 	std::vector<CatagoryValue> catagoryValues;
 	i32 footer;
 
-	void serialize(DataBuffer &buffer) {
-		auto &&header = *buffer.ctx<AssetCtx>().header;
+	//Owns the property trees in catagoryValues
+	PropertyArena arena;
 
-		if (buffer.loading) {
-			size_t catIdx = 0;
-			for(auto &&c : header.catagories) {
-				DataBuffer b = buffer.setupFromHere();
-				b.size = c.lengthV;
-
-				CatagoryValue v;
-
-				std::string name = header.getHeaderRef(header.getLinkRef(c.classIdx).property);
-				if (name == "DataTable") {
-					DataTableCategory dataCat;
-					b.serialize(dataCat);
-					v.value = std::move(dataCat);
-				}
-				else if (name == "HmxMidiSongAsset" || name == "HmxMidiFileAsset" || name == "HmxFusionAsset") {
-					HmxAssetFile asset;
-					b.serialize(asset);
-					v.value = std::move(asset);
-				}
-				else {
-					UObject object;
-					b.serialize(object);
-					v.value = std::move(object);
-				}
+	//Below this many exports or this much export data, handing the exports to the pool costs more than it saves.
+	//roundtrip_check --parallel-exports lowers both to put every asset through the parallel paths.
+	static inline size_t parallelExportCount = 2;
+	static inline size_t parallelExportBytes = 256 * 1024;
 
-				i32 nextStart = buffer.size - buffer.pos - 4;
-				if (catIdx + 1 < header.catagories.size()) {
-					nextStart = header.catagories[catIdx + 1].startV;
-				}
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		auto &&header = *buffer.template ctx<AssetCtx>().header;
 
-				i32 extraLen = nextStart - b.pos;
-				b.serializeWithSize(v.extraData, extraLen);
+		//Exports don't depend on each other, so a big asset with several is split across worker threads.
+		//When saving, the sizes are the ones it was loaded with.
+		size_t exportBytes = 0;
+		for (auto &&c : header.catagories) {
+			exportBytes += c.lengthV;
+		}
+		bool parallel = !header.catagories.empty() && header.catagories.size() >= parallelExportCount && exportBytes >= parallelExportBytes;
 
-				catagoryValues.emplace_back(std::move(v));
-				++catIdx;
+		if (buffer.loading) {
+			buffer.template ctx<AssetCtx>().arena = &arena;
 
-				buffer.pos = b.pos + b.derivedBuffer->offset;
+			if (parallel) {
+				loadParallel(buffer, header);
+			}
+			else {
+				size_t catIdx = 0;
+				for (auto &&c : header.catagories) {
+					auto b = buffer.setupFromHere();
+					b.size = c.lengthV;
+
+					CatagoryValue v;
+					loadCatagory(b, header, catIdx, v);
+					catagoryValues.emplace_back(std::move(v));
+					++catIdx;
+
+					buffer.endDerived(b);
+				}
 			}
 		}
 		else {
-			size_t idx = 0;
-			for (auto &&c : catagoryValues) {
-				
-				size_t start = buffer.pos;
+			//Slots can only be written side by side when the root has memory to write them into
+			auto &&root = buffer.rootBuffer();
+			if (parallel && !buffer.measuring && !root.sink && (root.buffer || root.target)) {
+				saveParallel(buffer, header);
+			}
+			else {
+				size_t idx = 0;
+				for (auto &&c : catagoryValues) {
+
+					size_t start = buffer.pos;
 
-				DataBuffer b = buffer.setupFromHere();
-				std::visit([&](auto &&v) {
-					b.serialize(v);
-				}, c.value);
+					auto b = buffer.setupFromHere();
+					std::visit([&](auto &&v) {
+						b.serialize(v);
+					}, c.value);
 
-				b.serializeWithSize(c.extraData, c.extraData.size());
+					b.serializeWithSize(c.extraData, c.extraData.size());
 
-				header.catagories[idx].startV = start;
-				header.catagories[idx].lengthV = b.size;
+					header.catagories[idx].startV = start;
+					header.catagories[idx].lengthV = b.size;
 
-				buffer.pos = b.pos + b.derivedBuffer->offset;
-				++idx;
+					buffer.endDerived(b);
+					++idx;
+				}
 			}
 		}
 
@@ -1183,21 +1475,185 @@ struct AssetData {
 
 		buffer.serialize(footer);
 		if (footer != 0x9E2A83C1) {
-			__debugbreak();
+			buffer.error("Bad asset data footer");
+		}
+	}
+
+private:
+	//Where the export after catIdx starts, relative to where catIdx started. b has just read catIdx.
+	static i32 nextCatagoryStart(const DataBuffer &b, const AssetHeader &header, size_t catIdx) {
+		if (catIdx + 1 < header.catagories.size()) {
+			return header.catagories[catIdx + 1].startV;
+		}
+		return b.derivedBuffer->base->size - b.derivedBuffer->offset - 4;
+	}
+
+	template<typename P>
+	static void loadCatagory(PolicyBuffer<P> &b, AssetHeader &header, size_t catIdx, CatagoryValue &v) {
+		auto &&c = header.catagories[catIdx];
+
+		std::string name = header.getHeaderRef(header.getLinkRef(c.classIdx).property);
+		if (name == "DataTable") {
+			DataTableCategory dataCat;
+			b.serialize(dataCat);
+			v.value = std::move(dataCat);
+		}
+		else if (name == "HmxMidiSongAsset" || name == "HmxMidiFileAsset" || name == "HmxFusionAsset") {
+			HmxAssetFile asset;
+			b.serialize(asset);
+			v.value = std::move(asset);
+		}
+		else {
+			UObject object;
+			b.serialize(object);
+			v.value = std::move(object);
+		}
+
+		i32 extraLen = nextCatagoryStart(b, header, catIdx) - b.pos;
+		b.serializeWithSize(v.extraData, extraLen);
+	}
+
+	//Where each export starts is known from the header before any of them are read, so each one gets its own buffer,
+	//context and arena on a worker. The arenas are merged into ours in export order once they're all done.
+	template<typename P>
+	void loadParallel(PolicyBuffer<P> &buffer, AssetHeader &header) {
+		size_t count = header.catagories.size();
+
+		std::vector<PolicyBuffer<P>> buffers;
+		buffers.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			auto b = buffer.setupFromHere();
+			b.size = header.catagories[i].lengthV;
+			buffers.emplace_back(std::move(b));
+
+			buffer.pos += nextCatagoryStart(buffers.back(), header, i);
+		}
+
+		std::vector<AssetCtx> ctxs(count, buffer.template ctx<AssetCtx>());
+		std::vector<PropertyArena> arenas(count);
+		std::vector<CatagoryValue> values(count);
+
+		//Workers only look names up, the index is built here so none of them has to
+		header.findName("None");
+
+		parallel_for(count, [&](size_t i) {
+			ctxs[i].arena = &arenas[i];
+			buffers[i].ctx_ = &ctxs[i];
+			loadCatagory(buffers[i], header, i, values[i]);
+		});
+
+		for (size_t i = 0; i < count; ++i) {
+			arena.merge(std::move(arenas[i]));
+			catagoryValues.emplace_back(std::move(values[i]));
+		}
+	}
+
+	//Every export is measured first, which gives each one a slot of its own. They're then written into their slots
+	//side by side, each through a root buffer of its own over just that slot. Fixup slots reserved while writing an export
+	//index into its writer, so the writers are kept and finalized along with the root, pointed at wherever the slot ended up.
+	template<typename P>
+	void saveParallel(PolicyBuffer<P> &buffer, AssetHeader &header) {
+		size_t count = catagoryValues.size();
+		std::vector<AssetCtx> ctxs(count, buffer.template ctx<AssetCtx>());
+
+		//Every property list ends in a None ref. Creating it here, along with the name index, leaves the workers only reading the header.
+		asset_helper::createNoneRef(buffer);
+
+		std::vector<size_t> sizes(count);
+		parallel_for(count, [&](size_t i) {
+			SizeBuffer m;
+			m.throwOnError = buffer.throwOnError;
+			m.ctx_ = &ctxs[i];
+			std::visit([&](auto &&v) {
+				m.serialize(v);
+			}, catagoryValues[i].value);
+			sizes[i] = m.size + catagoryValues[i].extraData.size();
+		});
+
+		std::vector<size_t> starts(count);
+		size_t end = buffer.pos;
+		for (size_t i = 0; i < count; ++i) {
+			starts[i] = end;
+			end += sizes[i];
+		}
+
+		auto &&root = buffer.rootBuffer();
+		size_t rootStart = buffer.rootPos();
+		size_t rootEnd = rootStart + (end - buffer.pos);
+		if (rootEnd > root.size) {
+			root.grow(rootEnd);
+		}
+
+		//Writers have no target, so a write past the slot is an error instead of growing into the next one
+		std::vector<std::shared_ptr<WriteBuffer>> writers(count);
+		parallel_for(count, [&](size_t i) {
+			auto w = std::make_shared<WriteBuffer>();
+			w->throwOnError = buffer.throwOnError;
+			w->buffer = root.buffer + rootStart + (starts[i] - buffer.pos);
+			w->size = sizes[i];
+			w->measuredSize = sizes[i];
+			w->ctx_ = &ctxs[i];
+			writers[i] = w;
+
+			std::visit([&](auto &&v) {
+				w->serialize(v);
+			}, catagoryValues[i].value);
+			w->serializeWithSize(catagoryValues[i].extraData, catagoryValues[i].extraData.size());
+
+			if (w->written != sizes[i]) {
+				w->error("Export " + std::to_string(i) + " wrote " + std::to_string(w->written) + " bytes, but was measured at " + std::to_string(sizes[i]), w->written);
+			}
+		});
+
+		for (size_t i = 0; i < count; ++i) {
+			auto &&w = writers[i];
+			if (!w->watchedValues.empty() || !w->fixups.empty() || !w->finalizeFunctions.empty()) {
+				size_t offset = rootStart + (starts[i] - buffer.pos);
+				root.finalizeFunctions.emplace_back([w, offset](DataBuffer &b) {
+					w->buffer = b.buffer + offset;
+					w->finalize();
+				});
+			}
+
+			header.catagories[i].startV = starts[i];
+			header.catagories[i].lengthV = sizes[i];
+		}
+
+		buffer.pos = end;
+		if (end > buffer.size) {
+			buffer.size = end;
 		}
 	}
 };
 
+//Works out which names the header and data still refer to, and sets up header.nameRemap so the next save leaves the rest
+//out of the table and remaps every ref on the way out. Nothing in memory changes, so refs held elsewhere stay valid.
+//Returns how many names will be left out. That's 0 if the data has bytes a ref could hide in (an UnknownProperty, or unparsed
+//bytes after an export), in which case the whole table is saved.
+size_t compactNames(AssetHeader &header, AssetData &data);
+
 struct Asset {
 	AssetHeader header;
 	AssetData data;
 
-	void serialize(DataBuffer &buffer) {
+	//Leave names nothing refers to out of the saved asset, see compactNames
+	bool dropUnusedNames = false;
+
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		AssetCtx ctx;
 		ctx.parseHeader = true;
 		ctx.header = &header;
 		buffer.ctx_ = &ctx;
 
+		if (!buffer.loading) {
+			header.nameRemap.clear();
+			if (dropUnusedNames) {
+				compactNames(header, data);
+			}
+			ctx.baseCtx.nameRemap = header.nameRemap.empty() ? nullptr : &header.nameRemap;
+		}
+
 		buffer.serialize(header);
 		buffer.serialize(data);
 	}
@@ -1211,10 +1667,14 @@ struct SaveFile {
 	std::string structName;
 	IPropertyDataList properties;
 
-	void serialize(DataBuffer &buffer) {
+	PropertyArena arena;
+
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		AssetCtx ctx;
 		ctx.baseCtx.useStringRef = false;
 		ctx.parsingSaveFormat = true;
+		ctx.arena = &arena;
 
 		buffer.ctx_ = &ctx;
 		buffer.serialize(start);
@@ -1226,8 +1686,17 @@ struct SaveFile {
 
 struct SHAHash {
 	u8 data[20];
-	void serialize(DataBuffer &buffer) {
-		buffer.watch([&]() { buffer.serialize(data); });
+
+	// Where this hash was written during the current save (volatile)
+	std::vector<DataBuffer::FixupSlot<u8[20]>> slots;
+	//
+
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
+		auto slot = buffer.reserve(data);
+		if (slot.valid()) {
+			slots.push_back(slot);
+		}
 	}
 };
 
@@ -1245,18 +1714,14 @@ struct FinalizeHash {
 
 		memcpy(hash->data, computedHash.digest, sizeof(computedHash.digest));
 
-		auto&& myData = hash->data;
-		bool found = false;
-		for (auto &&w : b.watchedValues) {
-			if (w.data == (u8*)myData) {
-				memcpy(b.buffer + w.buffer_pos, myData, sizeof(myData));
-				found = true;
-			}
+		if (hash->slots.empty()) {
+			__debugbreak();
 		}
 
-		if (!found) {
-			__debugbreak();
+		for (auto &&slot : hash->slots) {
+			b.patch(slot, hash->data);
 		}
+		hash->slots.clear();
 	}
 };
 //
@@ -1281,6 +1746,9 @@ enum class EPakVersion : u32
 	LATEST = LAST - 1
 };
 
+//Entries are named relative to the game's content folder, which paths inside assets start with
+static const std::string Game_Prefix = "/Game/";
+
 struct PakFile {
 	struct Info {
 		static const u32 OFFSET = 221;
@@ -1295,10 +1763,16 @@ struct PakFile {
 		bool isFrozen = false;
 		char compressionName[32];
 
-		void serialize(DataBuffer &buffer) {
+		template<typename P>
+		void serialize(PolicyBuffer<P> &buffer) {
 			size_t start = buffer.pos;
 
 			if (buffer.loading) {
+				if (buffer.size < OFFSET) {
+					buffer.error("File is too small to be a pak");
+					return;
+				}
+
 				buffer.pos = buffer.size - OFFSET;
 			}
 
@@ -1312,7 +1786,7 @@ struct PakFile {
 			buffer.serialize(version);
 			buffer.watch([&]() { buffer.serialize(indexOffset); });
 			buffer.watch([&]() { buffer.serialize(indexSize); });
-			buffer.watch([&]() { buffer.serialize(hash); });
+			buffer.serialize(hash);
 
 			if (version == EPakVersion::FROZEN_INDEX) {
 				buffer.serialize(isFrozen);
@@ -1346,7 +1820,38 @@ struct PakFile {
 			bool inFilePrefix = false;
 			//
 
-			void serialize(DataBuffer &buffer) {
+			//How an entry sits in the index, so it can be read in one go
+#pragma pack(push, 1)
+			struct Record {
+				i64 offset;
+				i64 size;
+				i64 uncompressedSize;
+				i32 compressionMethodIdx;
+				u8 hash[20];
+				u8 flags;
+				u32 compressionBlockSize;
+
+				static constexpr size_t fixed_layout_size = 53;
+			};
+#pragma pack(pop)
+
+			template<typename P>
+			void serialize(PolicyBuffer<P> &buffer) {
+				//Saving goes field by field, since most of these are watched for patching later
+				if (buffer.loading) {
+					Record record;
+					buffer.serialize(record);
+
+					offset = record.offset;
+					size = record.size;
+					uncompressedSize = record.uncompressedSize;
+					compressionMethodIdx = record.compressionMethodIdx;
+					memcpy(hash.data, record.hash, sizeof(hash.data));
+					flags = record.flags;
+					compressionBlockSize = record.compressionBlockSize;
+					return;
+				}
+
 				if (inFilePrefix) {
 					i64 null = 0;
 					buffer.serialize(null);
@@ -1358,7 +1863,7 @@ struct PakFile {
 				buffer.watch([&]() { buffer.serialize(size); });
 				buffer.watch([&]() { buffer.serialize(uncompressedSize); });
 				buffer.serialize(compressionMethodIdx);
-				buffer.watch([&]() { buffer.serialize(hash); });
+				buffer.serialize(hash);
 				if (compressionMethodIdx != 0) {
 
 				}
@@ -1373,11 +1878,16 @@ struct PakFile {
 			AssetData data;
 			size_t size;
 
-			void serialize(DataBuffer &buffer) {
+			template<typename P>
+			void serialize(PolicyBuffer<P> &buffer) {
 				auto header = &std::get<AssetHeader>(pakHeader->data);
 
 				AssetCtx ctx;
 				ctx.header = header;
+				ctx.deferProperties = buffer.loading && buffer.template ctx<PakFile>().deferProperties;
+				if (!buffer.loading && !header->nameRemap.empty()) {
+					ctx.baseCtx.nameRemap = &header->nameRemap;
+				}
 				buffer.ctx_ = &ctx;
 				buffer.serialize(data);
 
@@ -1392,7 +1902,28 @@ struct PakFile {
 
 		std::variant<AssetHeader, PakAssetData> data;
 
+		//The bytes of an entry loaded with lazyEntries, until it's decoded (volatile)
+		struct Pending {
+			DataBlob bytes;
+			PakFile *pak;
+			bool throwOnError;
+
+			//Set while the pair it's in is being decoded
+			bool decoding = false;
+		};
+		std::optional<Pending> pending;
+
+		bool isPending() const {
+			return pending.has_value();
+		}
+
+		//Decodes an entry left pending by lazyEntries. A .uasset and its .uexp are decoded together, since saving
+		//the header relies on its .uexp patching in the sizes. They only stop being pending once both decode,
+		//if either fails they're both still saved back as the bytes they were loaded from.
+		void load();
+
 		AssetHeader &getHeader() {
+			load();
 			if (auto pakData = std::get_if<PakAssetData>(&data)) {
 				return pakData->pakHeader->getHeader();
 			}
@@ -1401,10 +1932,35 @@ struct PakFile {
 		}
 
 		PakAssetData &getData() {
+			load();
 			return std::get<PakAssetData>(data);
 		}
+
+		//assetBuffer covers just the bytes of this entry
+		void decode(ReadBuffer &assetBuffer, PakFile &pak) {
+			if (name.find(".uasset") != std::string::npos) {
+				AssetHeader header;
+				assetBuffer.serialize(header);
+				data = header;
+			}
+			else if (name.find(".uexp") != std::string::npos) {
+				auto foundHeader = pak.findEntry(name.substr(0, name.size() - 5) + ".uasset");
+				if (foundHeader) {
+					foundHeader->load();
+
+					PakAssetData pakData;
+					pakData.pakHeader = foundHeader;
+
+					assetBuffer.ctx_ = &pak;
+					assetBuffer.serialize(pakData);
+
+					data = std::move(pakData);
+				}
+			}
+		}
 		
-		void serialize(DataBuffer &buffer) {
+		template<typename P>
+		void serialize(PolicyBuffer<P> &buffer) {
 			buffer.serialize(name);
 
 			size_t start = buffer.pos;
@@ -1414,36 +1970,35 @@ struct PakFile {
 			if (buffer.loading) {
 				size_t currentPos = buffer.pos;
 
-				if (name.find(".uasset") != std::string::npos) {
-					DataBuffer assetBuffer;
-					assetBuffer.buffer = buffer.buffer + entryData.offset + structOffset;
-					assetBuffer.size = entryData.uncompressedSize;
-
-					AssetHeader header;
-					assetBuffer.serialize(header);
-					data = header;
+				if (entryData.offset < 0 || entryData.uncompressedSize < 0 || (size_t)(entryData.offset + structOffset + entryData.uncompressedSize) > buffer.size) {
+					buffer.error("Pak entry " + name + " runs past the end of the file");
+					return;
 				}
-				else if (name.find(".uexp") != std::string::npos) {
-					auto searchStr = name.substr(0, name.size() - 5) + ".uasset";
-
-					PakEntry *foundHeader = nullptr;
-					for (auto &&e : buffer.ctx<PakFile>().entries) {
-						if (e.name == searchStr) {
-							foundHeader = &e;
-						}
-					}
 
-					if (foundHeader) {
-						PakAssetData pakData;
-						pakData.pakHeader = foundHeader;
+				auto &&pak = buffer.template ctx<PakFile>();
+				pak.entriesByName[name] = this - pak.entries.data();
 
-						DataBuffer assetBuffer;
-						assetBuffer.buffer = buffer.buffer + entryData.offset + structOffset;
-						assetBuffer.size = entryData.uncompressedSize;
-						assetBuffer.serialize(pakData);
+				u8 *entryStart = buffer.buffer + entryData.offset + structOffset;
 
-						data = std::move(pakData);
+				if (pak.lazyEntries) {
+					Pending p;
+					if (buffer.source) {
+						p.bytes.setView(buffer.source, entryStart - buffer.source->data(), entryData.uncompressedSize);
 					}
+					else {
+						p.bytes = std::vector<u8>(entryStart, entryStart + entryData.uncompressedSize);
+					}
+					p.pak = &pak;
+					p.throwOnError = buffer.throwOnError;
+					pending = std::move(p);
+				}
+				else {
+					ReadBuffer assetBuffer;
+					assetBuffer.source = buffer.source;
+					assetBuffer.throwOnError = buffer.throwOnError;
+					assetBuffer.buffer = entryStart;
+					assetBuffer.size = entryData.uncompressedSize;
+					decode(assetBuffer, pak);
 				}
 
 				buffer.pos = currentPos;
@@ -1456,55 +2011,159 @@ struct PakFile {
 	std::string mountPoint;
 	std::vector<PakEntry> entries;
 
-	void serialize(DataBuffer &buffer) {
+	//Leave asset properties undecoded until they're used, untouched ones are saved back byte for byte
+	bool deferProperties = true;
+
+	//Only read the index on load. Entries are decoded the first time getHeader or getData is called on them,
+	//or all at once with loadEntries. Entries never decoded are saved back byte for byte.
+	bool lazyEntries = false;
+
+	//Leave names nothing refers to out of every saved asset, see compactNames
+	bool dropUnusedNames = false;
+
+	//Entries by name, filled in as the index is read. Rename entries through renameEntry to keep it right. (volatile)
+	std::unordered_map<std::string, size_t> entriesByName;
+
+	PakEntry* findEntry(const std::string &name) {
+		auto it = entriesByName.find(name);
+		return it != entriesByName.end() ? &entries[it->second] : nullptr;
+	}
+
+	void renameEntry(PakEntry &e, const std::string &name) {
+		size_t idx = &e - entries.data();
+
+		auto it = entriesByName.find(e.name);
+		if (it != entriesByName.end() && it->second == idx) {
+			entriesByName.erase(it);
+		}
+
+		e.name = name;
+		entriesByName[name] = idx;
+	}
+
+	//Decodes every entry still pending, for walking e.data directly
+	void loadEntries() {
+		for (auto &&e : entries) {
+			e.load();
+		}
+	}
+
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.ctx_ = this;
 
 		if (buffer.loading) {
 			buffer.serialize(info_footer);
+			if (info_footer.magic != 0x5A6F12E1) {
+				buffer.error("Bad pak footer magic");
+				return;
+			}
+
 			buffer.pos = info_footer.indexOffset;
 
 			buffer.serialize(mountPoint);
+			entriesByName.clear();
 			buffer.serialize(entries);
 		}
 		else {
+			//Worked out up front, each header is written before the .uexp it describes
+			for (auto &&e : entries) {
+				if (auto pakData = std::get_if<PakEntry::PakAssetData>(&e.data)) {
+					auto &&header = e.getHeader();
+					header.nameRemap.clear();
+					if (dropUnusedNames) {
+						compactNames(header, pakData->data);
+					}
+				}
+			}
+
+			std::vector<FinalizeHash> entryHashes;
 			for (auto &&e : entries) {
 				e.entryData.offset = buffer.pos;
+				e.entryData.hash.slots.clear();
 
 				e.entryData.inFilePrefix = true;
 				buffer.serialize(e.entryData);
 				e.entryData.inFilePrefix = false;
 
+				//Never decoded, so the hash loaded with it still holds
+				if (e.pending) {
+					buffer.serializeWithSize(e.pending->bytes, e.pending->bytes.size());
+					continue;
+				}
+
 				std::visit([&](auto &&d) {
-					DataBuffer b = buffer.setupFromHere();
+					beginHash(buffer, buffer.pos);
+
+					auto b = buffer.setupFromHere();
 					b.serialize(d);
-					buffer.pos = b.pos + b.derivedBuffer->offset;
+					buffer.endDerived(b);
 
-					FinalizeHash fh;
-					fh.start = b.derivedBuffer->offset;
-					fh.size = b.size;
-					fh.hash = &e.entryData.hash;
-					buffer.finalizeFunctions.emplace_back(std::move(fh));
+					endHash(buffer, b.derivedBuffer->rootOffset, b.size, e.entryData.hash, &entryHashes);
 
 					e.entryData.size = b.size;
 					e.entryData.uncompressedSize = b.size;
 				}, e.data);
 			}
 
+			//No entry covers another's hash, so they're all hashed at once, biggest first so none is left running alone at the end.
+			//The index holds every entry hash, so it's hashed after them.
+			if (!entryHashes.empty()) {
+				std::sort(entryHashes.begin(), entryHashes.end(), [](const FinalizeHash &a, const FinalizeHash &b) {
+					return a.size > b.size;
+				});
+
+				buffer.finalizeFunctions.emplace_back([entryHashes = std::move(entryHashes)](DataBuffer &b) mutable {
+					parallel_for(entryHashes.size(), [&](size_t i) {
+						entryHashes[i](b);
+					});
+				});
+			}
+
 			info_footer.indexOffset = buffer.pos;
+			info_footer.hash.slots.clear();
+
+			beginHash(buffer, info_footer.indexOffset);
 			buffer.serialize(mountPoint);
 			buffer.serialize(entries);
 
 			info_footer.indexSize = buffer.pos - info_footer.indexOffset;
-
-			FinalizeHash fh;
-			fh.start = info_footer.indexOffset;
-			fh.size = info_footer.indexSize;
-			fh.hash = &info_footer.hash;
-			buffer.finalizeFunctions.emplace_back(std::move(fh));
+			endHash(buffer, info_footer.indexOffset, info_footer.indexSize, info_footer.hash);
 
 			buffer.serialize(info_footer);
 		}
 	}
+
+private:
+	//When saving through a sink the hash is computed as the bytes stream out, otherwise over the whole buffer at finalize
+	static void beginHash(DataBuffer &buffer, size_t start) {
+		if (buffer.sink) {
+			buffer.sink->beginHash(start);
+		}
+	}
+
+	//Hashes done at finalize go in batch when there is one, for the caller to run
+	static void endHash(DataBuffer &buffer, size_t start, size_t size, SHAHash &hash, std::vector<FinalizeHash> *batch = nullptr) {
+		if (buffer.sink) {
+			buffer.sink->endHash(start + size, hash.data);
+			for (auto &&slot : hash.slots) {
+				buffer.patch(slot, hash.data);
+			}
+			hash.slots.clear();
+		}
+		else {
+			FinalizeHash fh;
+			fh.start = start;
+			fh.size = size;
+			fh.hash = &hash;
+			if (batch) {
+				batch->emplace_back(fh);
+			}
+			else {
+				buffer.finalizeFunctions.emplace_back(std::move(fh));
+			}
+		}
+	}
 };
 
 struct PakSigFile {
@@ -1548,7 +2207,8 @@ struct PakSigFile {
 		0x2B, 0x2C, 0x32, 0x57, 0x5D, 0xB4, 0xDE, 0x99, 0x35, 0x06, 0x49, 0xFB, 0x45, 0x7F, 0x3A, 0xCA
 	};
 
-	void serialize(DataBuffer &buffer) {
+	template<typename P>
+	void serialize(PolicyBuffer<P> &buffer) {
 		buffer.serialize(magic);
 		buffer.serialize(version);
 